@@ -0,0 +1,72 @@
+#include "camera.h"
+#include <math.h>
+
+void initCamera(Camera* camera, u32 boardWidth, u32 boardHeight, u32 viewWidth, u32 viewHeight)
+{
+	camera->boardWidth = boardWidth;
+	camera->boardHeight = boardHeight;
+	camera->viewWidth = viewWidth;
+	camera->viewHeight = viewHeight;
+	double fitX = (double)boardWidth / viewWidth;
+	double fitY = (double)boardHeight / viewHeight;
+	camera->fitCellsPerPixel = fitX > fitY ? fitX : fitY;
+	resetCamera(camera);
+}
+
+void resetCamera(Camera* camera)
+{
+	camera->centerX = camera->boardWidth * 0.5;
+	camera->centerY = camera->boardHeight * 0.5;
+	camera->cellsPerPixel = camera->fitCellsPerPixel;
+}
+
+// keeps the middle of the view on the board
+static void clampCamera(Camera* camera)
+{
+	camera->centerX = camera->centerX < 0.0 ? 0.0 : (camera->centerX > camera->boardWidth ? camera->boardWidth : camera->centerX);
+	camera->centerY = camera->centerY < 0.0 ? 0.0 : (camera->centerY > camera->boardHeight ? camera->boardHeight : camera->centerY);
+}
+
+void panCamera(Camera* camera, double pixelsX, double pixelsY)
+{
+	camera->centerX += pixelsX * camera->cellsPerPixel;
+	camera->centerY += pixelsY * camera->cellsPerPixel;
+	clampCamera(camera);
+}
+
+void zoomCamera(Camera* camera, double factor, double pixelX, double pixelY)
+{
+	double minimum = 1.0 / MAX_CAMERA_MAGNIFICATION;
+	double maximum = camera->fitCellsPerPixel * MAX_CAMERA_OVERVIEW;
+	double cellsPerPixel = camera->cellsPerPixel * factor;
+	cellsPerPixel = cellsPerPixel < minimum ? minimum : (cellsPerPixel > maximum ? maximum : cellsPerPixel);
+
+	// the offset from the middle to the pixel scales with the zoom
+	double offsetX = pixelX - camera->viewWidth * 0.5;
+	double offsetY = pixelY - camera->viewHeight * 0.5;
+	camera->centerX += offsetX * (camera->cellsPerPixel - cellsPerPixel);
+	camera->centerY += offsetY * (camera->cellsPerPixel - cellsPerPixel);
+	camera->cellsPerPixel = cellsPerPixel;
+	clampCamera(camera);
+}
+
+void cameraOrigin(const Camera* camera, double* x, double* y)
+{
+	*x = camera->centerX - camera->viewWidth * 0.5 * camera->cellsPerPixel;
+	*y = camera->centerY - camera->viewHeight * 0.5 * camera->cellsPerPixel;
+}
+
+u32 scaleLevel(double cellsPerPixel)
+{
+	// a pixel spanning more than a block could miss a live cell between samples
+	if (cellsPerPixel <= 1.0)
+	{
+		return 0;
+	}
+	return (u32)ceil(log2(cellsPerPixel));
+}
+
+u32 cameraLevel(const Camera* camera)
+{
+	return scaleLevel(camera->cellsPerPixel);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common.h"
+
+// how far the view can zoom in, in pixels a cell
+static const double MAX_CAMERA_MAGNIFICATION = 64.0;
+// how far past fitting the whole board the view can zoom out
+static const double MAX_CAMERA_OVERVIEW = 4.0;
+
+// pan and zoom over the board. positions are in cells with y up like the
+// board, the view in pixels with y up like gl_FragCoord.
+struct Camera
+{
+	u32 boardWidth;
+	u32 boardHeight;
+	u32 viewWidth;
+	u32 viewHeight;
+	// board position at the middle of the view
+	double centerX;
+	double centerY;
+	double cellsPerPixel;
+	double fitCellsPerPixel;
+};
+
+// starts out showing the whole board
+void initCamera(Camera* camera, u32 boardWidth, u32 boardHeight, u32 viewWidth, u32 viewHeight);
+void resetCamera(Camera* camera);
+void panCamera(Camera* camera, double pixelsX, double pixelsY);
+// scales the cells a pixel by factor, keeping the cell under the pixel in place
+void zoomCamera(Camera* camera, double factor, double pixelX, double pixelY);
+
+// the board position at the bottom left corner of the view
+void cameraOrigin(const Camera* camera, double* x, double* y);
+// the pyramid level whose blocks are at least a pixel, 0 for cells
+u32 scaleLevel(double cellsPerPixel);
+u32 cameraLevel(const Camera* camera);
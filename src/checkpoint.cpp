@@ -0,0 +1,285 @@
+#include "checkpoint.h"
+#include "checksum.h"
+#include "life.h"
+#include "platform.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+static const u32 CHECKPOINT_BAND_CELLS = 256 * 1024;
+
+enum CheckpointBandState
+{
+	BAND_PENDING,
+	BAND_WRITER_COPYING,
+	BAND_WRITER_COPIED,
+	BAND_SIM_COPYING,
+	BAND_SIM_COPIED,
+};
+
+static u32 bandCells(const Checkpointer* checkpointer, u32 band)
+{
+	u32 firstRow = band * checkpointer->bandRows;
+	u32 rows = checkpointer->height - firstRow < checkpointer->bandRows ? checkpointer->height - firstRow : checkpointer->bandRows;
+	return rows * checkpointer->width;
+}
+
+static const u32* bandSource(const Checkpointer* checkpointer, u32 band)
+{
+	return checkpointer->source + (size_t)band * checkpointer->bandRows * checkpointer->width;
+}
+
+static bool writeCheckpointFile(Checkpointer* checkpointer)
+{
+	FILE* file = fopen(checkpointer->tempPath.c_str(), "wb");
+	if (!file)
+	{
+		printf("failed to open checkpoint %s\n", checkpointer->tempPath.c_str());
+		return false;
+	}
+
+	CheckpointHeader header = {};
+	header.magic = CHECKPOINT_MAGIC;
+	header.version = CHECKPOINT_VERSION;
+	header.width = checkpointer->width;
+	header.height = checkpointer->height;
+	header.generation = checkpointer->generation;
+	header.bandRows = checkpointer->bandRows;
+	header.bandCount = checkpointer->bandCount;
+	header.checksum = crc32(0, &header, offsetof(CheckpointHeader, checksum));
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	u32 bandChecksums = 0;
+	for (u32 band = 0; band < checkpointer->bandCount; band++)
+	{
+		std::atomic<u32>& state = checkpointer->bandStates[band];
+		u32 cells = bandCells(checkpointer, band);
+		const u32* data = NULL;
+
+		// take the band from the live buffer unless the simulation got to it first
+		u32 expected = BAND_PENDING;
+		if (state.compare_exchange_strong(expected, BAND_WRITER_COPYING))
+		{
+			checkpointer->scratch.assign(bandSource(checkpointer, band), bandSource(checkpointer, band) + cells);
+			state.store(BAND_WRITER_COPIED);
+			data = checkpointer->scratch.data();
+		}
+		else
+		{
+			while (state.load() != BAND_SIM_COPIED)
+			{
+				std::this_thread::yield();
+			}
+			data = checkpointer->savedBands[band].data();
+		}
+
+		CheckpointBand bandHeader;
+		bandHeader.size = cells * sizeof(u32);
+		bandHeader.checksum = crc32(0, data, bandHeader.size);
+		bandChecksums = crc32(bandChecksums, &bandHeader.checksum, sizeof(u32));
+		ok = ok && fwrite(&bandHeader, sizeof(bandHeader), 1, file) == 1;
+		ok = ok && fwrite(data, bandHeader.size, 1, file) == 1;
+	}
+
+	CheckpointTrailer trailer = {};
+	trailer.magic = CHECKPOINT_TRAILER_MAGIC;
+	trailer.bandCount = checkpointer->bandCount;
+	trailer.generation = checkpointer->generation;
+	trailer.checksum = bandChecksums;
+	ok = ok && fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+	ok = ok && syncFile(file);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok || !replaceFile(checkpointer->tempPath.c_str(), checkpointer->path.c_str()))
+	{
+		printf("failed to write checkpoint %s\n", checkpointer->path.c_str());
+		remove(checkpointer->tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+static void writerThread(Checkpointer* checkpointer)
+{
+	std::unique_lock<std::mutex> guard(checkpointer->lock);
+	for (;;)
+	{
+		checkpointer->wake.wait(guard, [checkpointer] { return checkpointer->stopping || checkpointer->requested; });
+		if (!checkpointer->requested)
+		{
+			break;
+		}
+		checkpointer->requested = false;
+		guard.unlock();
+
+		writeCheckpointFile(checkpointer);
+		for (u32 band = 0; band < checkpointer->bandCount; band++)
+		{
+			std::vector<u32>().swap(checkpointer->savedBands[band]);
+		}
+
+		guard.lock();
+		checkpointer->busy.store(false);
+		checkpointer->wake.notify_all();
+	}
+}
+
+bool restoreCheckpoint(const char* path, Life* life)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	CheckpointHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		header.magic != CHECKPOINT_MAGIC ||
+		header.checksum != crc32(0, &header, offsetof(CheckpointHeader, checksum)))
+	{
+		printf("%s is not a checkpoint\n", path);
+		fclose(file);
+		return false;
+	}
+	if (header.version != CHECKPOINT_VERSION)
+	{
+		printf("checkpoint %s has unsupported version %u\n", path, header.version);
+		fclose(file);
+		return false;
+	}
+	if (header.width < 3 || header.height < 3 || header.bandRows == 0 ||
+		header.bandCount != (header.height + header.bandRows - 1) / header.bandRows)
+	{
+		printf("checkpoint %s has a corrupt header\n", path);
+		fclose(file);
+		return false;
+	}
+
+	initLife(life, header.width, header.height);
+	u32* ages = currentAges(life);
+	u32 bandChecksums = 0;
+	bool ok = true;
+	for (u32 band = 0; band < header.bandCount && ok; band++)
+	{
+		u32 firstRow = band * header.bandRows;
+		u32 rows = header.height - firstRow < header.bandRows ? header.height - firstRow : header.bandRows;
+		u32* data = ages + (size_t)firstRow * header.width;
+
+		CheckpointBand bandHeader;
+		ok = fread(&bandHeader, sizeof(bandHeader), 1, file) == 1 &&
+			 bandHeader.size == rows * header.width * sizeof(u32) &&
+			 fread(data, bandHeader.size, 1, file) == 1 &&
+			 crc32(0, data, bandHeader.size) == bandHeader.checksum;
+		bandChecksums = crc32(bandChecksums, &bandHeader.checksum, sizeof(u32));
+	}
+
+	CheckpointTrailer trailer;
+	ok = ok && fread(&trailer, sizeof(trailer), 1, file) == 1 &&
+		 trailer.magic == CHECKPOINT_TRAILER_MAGIC &&
+		 trailer.bandCount == header.bandCount &&
+		 trailer.generation == header.generation &&
+		 trailer.checksum == bandChecksums;
+	fclose(file);
+
+	if (!ok)
+	{
+		printf("checkpoint %s is corrupt\n", path);
+		initLife(life, header.width, header.height);
+		return false;
+	}
+	life->generation = header.generation;
+	return true;
+}
+
+void startCheckpointer(Checkpointer* checkpointer, const char* path)
+{
+	checkpointer->path = path;
+	checkpointer->tempPath = checkpointer->path + ".tmp";
+	checkpointer->requested = false;
+	checkpointer->stopping = false;
+	checkpointer->busy.store(false);
+	checkpointer->source = NULL;
+	checkpointer->bandCount = 0;
+	checkpointer->protecting = false;
+	checkpointer->writer = std::thread(writerThread, checkpointer);
+}
+
+bool beginCheckpoint(Checkpointer* checkpointer, const Life* life)
+{
+	if (checkpointer->busy.load())
+	{
+		return false;
+	}
+
+	checkpointer->source = currentAges(life);
+	checkpointer->width = life->width;
+	checkpointer->height = life->height;
+	checkpointer->generation = life->generation;
+	checkpointer->bandRows = CHECKPOINT_BAND_CELLS / life->width ? CHECKPOINT_BAND_CELLS / life->width : 1;
+	u32 bandCount = (life->height + checkpointer->bandRows - 1) / checkpointer->bandRows;
+	if (bandCount != checkpointer->bandCount)
+	{
+		checkpointer->bandStates.reset(new std::atomic<u32>[bandCount]);
+		checkpointer->bandCount = bandCount;
+	}
+	for (u32 band = 0; band < bandCount; band++)
+	{
+		checkpointer->bandStates[band].store(BAND_PENDING);
+	}
+	checkpointer->savedBands.resize(bandCount);
+	checkpointer->protecting = true;
+	checkpointer->busy.store(true);
+
+	{
+		std::lock_guard<std::mutex> guard(checkpointer->lock);
+		checkpointer->requested = true;
+	}
+	checkpointer->wake.notify_all();
+	return true;
+}
+
+void protectCheckpoint(Checkpointer* checkpointer, const u32* buffer)
+{
+	if (!checkpointer->protecting || checkpointer->source != buffer)
+	{
+		return;
+	}
+
+	for (u32 band = 0; band < checkpointer->bandCount; band++)
+	{
+		std::atomic<u32>& state = checkpointer->bandStates[band];
+		u32 expected = BAND_PENDING;
+		if (state.compare_exchange_strong(expected, BAND_SIM_COPYING))
+		{
+			checkpointer->savedBands[band].assign(bandSource(checkpointer, band), bandSource(checkpointer, band) + bandCells(checkpointer, band));
+			state.store(BAND_SIM_COPIED);
+		}
+		else
+		{
+			while (state.load() == BAND_WRITER_COPYING)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+	checkpointer->protecting = false;
+}
+
+void waitForCheckpoint(Checkpointer* checkpointer)
+{
+	std::unique_lock<std::mutex> guard(checkpointer->lock);
+	checkpointer->wake.wait(guard, [checkpointer] { return !checkpointer->busy.load(); });
+}
+
+void stopCheckpointer(Checkpointer* checkpointer)
+{
+	waitForCheckpoint(checkpointer);
+	{
+		std::lock_guard<std::mutex> guard(checkpointer->lock);
+		checkpointer->stopping = true;
+	}
+	checkpointer->wake.notify_all();
+	checkpointer->writer.join();
+	checkpointer->savedBands.clear();
+	checkpointer->scratch.clear();
+}
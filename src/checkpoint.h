@@ -0,0 +1,87 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Life;
+
+// a checkpoint is a header, the ages split into bands of rows that each carry
+// a crc32, and a trailer that is only written once every band made it out.
+// the file is written next to the target and renamed over it after an fsync,
+// so a crash leaves either the previous checkpoint or the new one.
+static const u32 CHECKPOINT_MAGIC = 0x4b43474c; // "LGCK"
+static const u32 CHECKPOINT_TRAILER_MAGIC = 0x4543474c; // "LGCE"
+static const u32 CHECKPOINT_VERSION = 1;
+static const u32 DEFAULT_CHECKPOINT_INTERVAL = 3600;
+
+struct CheckpointHeader
+{
+	u32 magic;
+	u32 version;
+	u32 width;
+	u32 height;
+	u64 generation;
+	u32 bandRows;
+	u32 bandCount;
+	u32 reserved;
+	u32 checksum;
+};
+
+struct CheckpointBand
+{
+	u32 size;
+	u32 checksum;
+};
+
+struct CheckpointTrailer
+{
+	u32 magic;
+	u32 bandCount;
+	u64 generation;
+	u32 checksum;
+	u32 reserved;
+};
+
+// the snapshot is never copied up front. the writer copies one band at a time
+// out of the live age buffer, and before the simulation overwrites that buffer
+// it copies whatever bands the writer hasn't reached yet (protectCheckpoint).
+struct Checkpointer
+{
+	std::string path;
+	std::string tempPath;
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool requested;
+	bool stopping;
+	std::atomic<bool> busy;
+
+	// the snapshot being written
+	const u32* source;
+	u32 width;
+	u32 height;
+	u64 generation;
+	u32 bandRows;
+	u32 bandCount;
+	std::unique_ptr<std::atomic<u32>[]> bandStates;
+	std::vector<std::vector<u32>> savedBands;
+	bool protecting;
+
+	// only touched by the writer thread
+	std::vector<u32> scratch;
+};
+
+bool restoreCheckpoint(const char* path, Life* life);
+
+void startCheckpointer(Checkpointer* checkpointer, const char* path);
+bool beginCheckpoint(Checkpointer* checkpointer, const Life* life);
+void protectCheckpoint(Checkpointer* checkpointer, const u32* buffer);
+void waitForCheckpoint(Checkpointer* checkpointer);
+void stopCheckpointer(Checkpointer* checkpointer);
@@ -0,0 +1,32 @@
+#include "checksum.h"
+
+struct Crc32Table
+{
+	u32 entries[256];
+
+	Crc32Table()
+	{
+		for (u32 i = 0; i < 256; i++)
+		{
+			u32 value = i;
+			for (u32 bit = 0; bit < 8; bit++)
+			{
+				value = (value >> 1) ^ (value & 1 ? 0xedb88320 : 0);
+			}
+			entries[i] = value;
+		}
+	}
+};
+
+u32 crc32(u32 crc, const void* data, size_t size)
+{
+	static const Crc32Table table;
+
+	const u8* bytes = (const u8*)data;
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table.entries[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
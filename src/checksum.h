@@ -0,0 +1,7 @@
+#pragma once
+
+#include "common.h"
+#include <stddef.h>
+
+// the crc32 zlib and png use, chains from a previous result or 0
+u32 crc32(u32 crc, const void* data, size_t size);
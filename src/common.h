@@ -0,0 +1,20 @@
+#pragma once
+
+typedef unsigned char u8;
+typedef unsigned int u32;
+typedef unsigned long long u64;
+typedef long long i64;
+
+inline u64 popCount(u64 bits)
+{
+	bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+	bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+	bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+	return (bits * 0x0101010101010101ull) >> 56;
+}
+
+// index of the lowest set bit, bits can't be 0
+inline u32 ctz64(u64 bits)
+{
+	return (u32)popCount((bits & (0 - bits)) - 1);
+}
@@ -0,0 +1,122 @@
+#include "damage.h"
+#include "life.h"
+#include <math.h>
+
+void clearDamage(Damage* damage, u32 width, u32 height)
+{
+	damage->width = width;
+	damage->height = height;
+	damage->full = false;
+	for (u32 i = 0; i < DAMAGE_BANDS; i++)
+	{
+		damage->bands[i] = {width, height, 0, 0};
+	}
+}
+
+void damageWindow(Damage* damage)
+{
+	damage->full = true;
+}
+
+// the pixels whose centres fall in [first, end) texels, a pixel wider on each
+// side for the float rounding in the shaders and the sparse quads' minimum size
+static void pixelSpan(double first, double end, double origin, double cellsPerPixel, u32 size, u32* pixel0, u32* pixel1)
+{
+	double start = floor((first - origin) / cellsPerPixel - 0.5) - 1.0;
+	double stop = ceil((end - origin) / cellsPerPixel - 0.5) + 1.0;
+	*pixel0 = start < 0.0 ? 0 : start > size ? size : (u32)start;
+	*pixel1 = stop < 0.0 ? 0 : stop > size ? size : (u32)stop;
+}
+
+static void addBox(Damage* damage, u32 x0, u32 y0, u32 x1, u32 y1)
+{
+	for (u32 i = 0; i < DAMAGE_BANDS; i++)
+	{
+		u32 top = damage->height * i / DAMAGE_BANDS;
+		u32 bottom = damage->height * (i + 1) / DAMAGE_BANDS;
+		if (y1 <= top || y0 >= bottom)
+		{
+			continue;
+		}
+		u32 bandY0 = y0 > top ? y0 : top;
+		u32 bandY1 = y1 < bottom ? y1 : bottom;
+		DamageBox* band = &damage->bands[i];
+		band->x0 = x0 < band->x0 ? x0 : band->x0;
+		band->y0 = bandY0 < band->y0 ? bandY0 : band->y0;
+		band->x1 = x1 > band->x1 ? x1 : band->x1;
+		band->y1 = bandY1 > band->y1 ? bandY1 : band->y1;
+	}
+}
+
+void damageTiles(Damage* damage, const u8* tiles, u32 tileColumns, u32 tileRows, double originX, double originY, double cellsPerPixel, u32 level)
+{
+	if (damage->full)
+	{
+		return;
+	}
+	// a pooled block can reach past the tiles under it
+	double block = (double)(1u << level);
+
+	// only the tiles in view are looked at
+	double viewEndX = originX + damage->width * cellsPerPixel;
+	double viewEndY = originY + damage->height * cellsPerPixel;
+	double firstColumn = floor((originX - block) / DIRTY_TILE_WIDTH);
+	double firstRow = floor((originY - block) / DIRTY_TILE_HEIGHT);
+	double endColumn = ceil((viewEndX + block) / DIRTY_TILE_WIDTH);
+	double endRow = ceil((viewEndY + block) / DIRTY_TILE_HEIGHT);
+	u32 column0 = firstColumn < 0.0 ? 0 : firstColumn > tileColumns ? tileColumns : (u32)firstColumn;
+	u32 row0 = firstRow < 0.0 ? 0 : firstRow > tileRows ? tileRows : (u32)firstRow;
+	u32 column1 = endColumn < 0.0 ? 0 : endColumn > tileColumns ? tileColumns : (u32)endColumn;
+	u32 row1 = endRow < 0.0 ? 0 : endRow > tileRows ? tileRows : (u32)endRow;
+
+	for (u32 y = row0; y < row1; y++)
+	{
+		const u8* row = tiles + (size_t)y * tileColumns;
+		for (u32 x = column0; x < column1; x++)
+		{
+			if (!row[x])
+			{
+				continue;
+			}
+			// a run of dirty tiles is one box
+			u32 end = x + 1;
+			while (end < column1 && row[end])
+			{
+				end++;
+			}
+			double cellX0 = floor((double)x * DIRTY_TILE_WIDTH / block) * block;
+			double cellX1 = ceil((double)end * DIRTY_TILE_WIDTH / block) * block;
+			double cellY0 = floor((double)y * DIRTY_TILE_HEIGHT / block) * block;
+			double cellY1 = ceil((double)(y + 1) * DIRTY_TILE_HEIGHT / block) * block;
+			u32 x0, x1, y0, y1;
+			pixelSpan(cellX0, cellX1, originX, cellsPerPixel, damage->width, &x0, &x1);
+			pixelSpan(cellY0, cellY1, originY, cellsPerPixel, damage->height, &y0, &y1);
+			if (x0 < x1 && y0 < y1)
+			{
+				addBox(damage, x0, y0, x1, y1);
+			}
+			x = end;
+		}
+	}
+}
+
+u32 damageBoxes(const Damage* damage, DamageBox* boxes)
+{
+	u64 area = 0;
+	u32 count = 0;
+	for (u32 i = 0; i < DAMAGE_BANDS && !damage->full; i++)
+	{
+		const DamageBox* band = &damage->bands[i];
+		if (band->x0 < band->x1)
+		{
+			area += (u64)(band->x1 - band->x0) * (band->y1 - band->y0);
+			boxes[count++] = *band;
+		}
+	}
+	if (damage->full || area * DAMAGE_FULL_FRACTION > (u64)damage->width * damage->height)
+	{
+		boxes[0] = {0, 0, damage->width, damage->height};
+		return 1;
+	}
+	return count;
+}
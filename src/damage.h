@@ -0,0 +1,39 @@
+#pragma once
+
+#include "common.h"
+
+// the parts of the window a frame has to redraw. every dirty tile in view
+// covers a box of the window, and the boxes are merged into one for each
+// horizontal band of the window, so a frame is at most DAMAGE_BANDS
+// scissored draws. past 1 / DAMAGE_FULL_FRACTION of the window the whole of
+// it is drawn in one go instead.
+static const u32 DAMAGE_BANDS = 8;
+static const u32 DAMAGE_FULL_FRACTION = 2;
+
+// pixels, x1 and y1 are past the end. empty when x0 >= x1.
+struct DamageBox
+{
+	u32 x0;
+	u32 y0;
+	u32 x1;
+	u32 y1;
+};
+
+struct Damage
+{
+	u32 width;
+	u32 height;
+	bool full;
+	DamageBox bands[DAMAGE_BANDS];
+};
+
+// nothing damaged in a width x height window
+void clearDamage(Damage* damage, u32 width, u32 height);
+void damageWindow(Damage* damage);
+// adds the pixels that show the dirty tiles of a frame, see Life. origin and
+// cellsPerPixel are in the frame's texels like the shaders get them, level
+// is the pyramid level drawn.
+void damageTiles(Damage* damage, const u8* tiles, u32 tileColumns, u32 tileRows, double originX, double originY, double cellsPerPixel, u32 level);
+// writes the boxes to draw to boxes, which holds DAMAGE_BANDS, and returns
+// how many there are. a full window is one box.
+u32 damageBoxes(const Damage* damage, DamageBox* boxes);
@@ -0,0 +1,552 @@
+#include "exporter.h"
+#include "checksum.h"
+#include "platform.h"
+#include <string.h>
+
+static const u32 EXPORT_WRITE_BUFFER_SIZE = 4 * 1024 * 1024;
+// a readback that's due is waited on in slices of this
+static const u64 EXPORT_WAIT_NANOSECONDS = 1000000;
+
+// deflate with the fixed huffman codes. the only matches looked for are the
+// previous pixel and the pixel above, which is where nearly all the
+// repetition in a frame of cells is.
+static const u32 DEFLATE_MAX_MATCH = 258;
+static const u32 LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const u8 LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const u32 DISTANCE_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const u8 DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const u32 DEFLATE_MAX_DISTANCE = 32768;
+
+struct BitWriter
+{
+	std::vector<u8>* out;
+	u32 bits;
+	u32 count;
+};
+
+static void putBits(BitWriter* writer, u32 value, u32 count)
+{
+	writer->bits |= value << writer->count;
+	writer->count += count;
+	while (writer->count >= 8)
+	{
+		writer->out->push_back((u8)writer->bits);
+		writer->bits >>= 8;
+		writer->count -= 8;
+	}
+}
+
+// huffman codes go out most significant bit first
+static void putCode(BitWriter* writer, u32 code, u32 length)
+{
+	u32 reversed = 0;
+	for (u32 i = 0; i < length; i++)
+	{
+		reversed = (reversed << 1) | ((code >> i) & 1);
+	}
+	putBits(writer, reversed, length);
+}
+
+static void putSymbol(BitWriter* writer, u32 symbol)
+{
+	if (symbol < 144)
+	{
+		putCode(writer, 0x30 + symbol, 8);
+	}
+	else if (symbol < 256)
+	{
+		putCode(writer, 0x190 + symbol - 144, 9);
+	}
+	else if (symbol < 280)
+	{
+		putCode(writer, symbol - 256, 7);
+	}
+	else
+	{
+		putCode(writer, 0xc0 + symbol - 280, 8);
+	}
+}
+
+static void putMatch(BitWriter* writer, u32 length, u32 distance)
+{
+	u32 code = 28;
+	while (LENGTH_BASE[code] > length)
+	{
+		code--;
+	}
+	putSymbol(writer, 257 + code);
+	putBits(writer, length - LENGTH_BASE[code], LENGTH_EXTRA[code]);
+
+	code = 29;
+	while (DISTANCE_BASE[code] > distance)
+	{
+		code--;
+	}
+	putCode(writer, code, 5);
+	putBits(writer, distance - DISTANCE_BASE[code], DISTANCE_EXTRA[code]);
+}
+
+static u32 matchLength(const u8* data, size_t position, size_t size, u32 distance)
+{
+	if (distance > position || distance > DEFLATE_MAX_DISTANCE)
+	{
+		return 0;
+	}
+	size_t limit = size - position < DEFLATE_MAX_MATCH ? size - position : DEFLATE_MAX_MATCH;
+	const u8* from = data + position - distance;
+	const u8* to = data + position;
+	u32 length = 0;
+	while (length < limit && from[length] == to[length])
+	{
+		length++;
+	}
+	return length;
+}
+
+static u32 adler32(const u8* data, size_t size)
+{
+	u32 a = 1;
+	u32 b = 0;
+	while (size)
+	{
+		// the most bytes before b can overflow
+		size_t chunk = size < 5552 ? size : 5552;
+		for (size_t i = 0; i < chunk; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += chunk;
+		size -= chunk;
+	}
+	return (b << 16) | a;
+}
+
+static void putU32(std::vector<u8>* out, u32 value)
+{
+	out->push_back((u8)(value >> 24));
+	out->push_back((u8)(value >> 16));
+	out->push_back((u8)(value >> 8));
+	out->push_back((u8)value);
+}
+
+// a zlib stream of one fixed huffman block
+static void deflate(const u8* data, size_t size, u32 stride, std::vector<u8>* out)
+{
+	out->push_back(0x78);
+	out->push_back(0x01);
+	BitWriter writer = {out, 0, 0};
+	// final block, fixed codes
+	putBits(&writer, 1, 1);
+	putBits(&writer, 1, 2);
+	size_t position = 0;
+	while (position < size)
+	{
+		u32 left = matchLength(data, position, size, 3);
+		u32 up = matchLength(data, position, size, stride);
+		u32 length = left >= up ? left : up;
+		if (length >= 3)
+		{
+			putMatch(&writer, length, left >= up ? 3 : stride);
+			position += length;
+		}
+		else
+		{
+			putSymbol(&writer, data[position]);
+			position++;
+		}
+	}
+	putSymbol(&writer, 256);
+	putBits(&writer, 0, 7);
+	putU32(out, adler32(data, size));
+}
+
+static void beginChunk(std::vector<u8>* out, const char* type)
+{
+	// the length is filled in by endChunk
+	putU32(out, 0);
+	out->insert(out->end(), type, type + 4);
+}
+
+static void endChunk(std::vector<u8>* out, size_t start)
+{
+	size_t size = out->size() - start - 8;
+	u8* length = out->data() + start;
+	length[0] = (u8)(size >> 24);
+	length[1] = (u8)(size >> 16);
+	length[2] = (u8)(size >> 8);
+	length[3] = (u8)size;
+	putU32(out, crc32(0, out->data() + start + 4, size + 4));
+}
+
+// 8 bit rgb, rows flipped to run top down and alpha dropped
+static void encodePng(const Exporter* exporter, ExportJob* job)
+{
+	u32 stride = exporter->width * 3 + 1;
+	job->rows.resize((size_t)stride * exporter->height);
+	for (u32 y = 0; y < exporter->height; y++)
+	{
+		const u8* pixel = job->pixels.data() + (size_t)(exporter->height - 1 - y) * exporter->width * 4;
+		u8* row = job->rows.data() + (size_t)y * stride;
+		// no filter
+		*row++ = 0;
+		for (u32 x = 0; x < exporter->width; x++)
+		{
+			row[0] = pixel[0];
+			row[1] = pixel[1];
+			row[2] = pixel[2];
+			row += 3;
+			pixel += 4;
+		}
+	}
+
+	std::vector<u8>* out = &job->encoded;
+	static const u8 signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	out->assign(signature, signature + sizeof(signature));
+
+	size_t start = out->size();
+	beginChunk(out, "IHDR");
+	putU32(out, exporter->width);
+	putU32(out, exporter->height);
+	// bit depth, truecolour, deflate, no filtering choice, not interlaced
+	const u8 format[5] = {8, 2, 0, 0, 0};
+	out->insert(out->end(), format, format + sizeof(format));
+	endChunk(out, start);
+
+	start = out->size();
+	beginChunk(out, "IDAT");
+	deflate(job->rows.data(), job->rows.size(), stride, out);
+	endChunk(out, start);
+
+	start = out->size();
+	beginChunk(out, "IEND");
+	endChunk(out, start);
+}
+
+static u8 clampByte(i64 value)
+{
+	return (u8)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// full range bt.601 like jpeg, chroma averaged over 2x2 blocks
+static void encodeY4m(const Exporter* exporter, ExportJob* job)
+{
+	u32 width = exporter->width;
+	u32 height = exporter->height;
+	u32 chromaWidth = (width + 1) / 2;
+	u32 chromaHeight = (height + 1) / 2;
+	static const char frameHeader[] = "FRAME\n";
+	size_t headerSize = sizeof(frameHeader) - 1;
+	size_t lumaSize = (size_t)width * height;
+	size_t chromaSize = (size_t)chromaWidth * chromaHeight;
+	job->encoded.resize(headerSize + lumaSize + 2 * chromaSize);
+	memcpy(job->encoded.data(), frameHeader, headerSize);
+	u8* luma = job->encoded.data() + headerSize;
+	u8* blue = luma + lumaSize;
+	u8* red = blue + chromaSize;
+
+	const u8* pixels = job->pixels.data();
+	for (u32 y = 0; y < height; y++)
+	{
+		const u8* pixel = pixels + (size_t)(height - 1 - y) * width * 4;
+		u8* row = luma + (size_t)y * width;
+		for (u32 x = 0; x < width; x++)
+		{
+			row[x] = (u8)((77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8);
+			pixel += 4;
+		}
+	}
+	for (u32 y = 0; y < chromaHeight; y++)
+	{
+		for (u32 x = 0; x < chromaWidth; x++)
+		{
+			i64 r = 0, g = 0, b = 0, count = 0;
+			for (u32 j = 2 * y; j < 2 * y + 2 && j < height; j++)
+			{
+				const u8* pixel = pixels + ((size_t)(height - 1 - j) * width + 2 * x) * 4;
+				for (u32 i = 2 * x; i < 2 * x + 2 && i < width; i++)
+				{
+					r += pixel[0];
+					g += pixel[1];
+					b += pixel[2];
+					count++;
+					pixel += 4;
+				}
+			}
+			i64 half = 128 * count;
+			blue[(size_t)y * chromaWidth + x] = clampByte(128 + (-43 * r - 85 * g + 128 * b + half) / (256 * count));
+			red[(size_t)y * chromaWidth + x] = clampByte(128 + (128 * r - 107 * g - 21 * b + half) / (256 * count));
+		}
+	}
+}
+
+static bool writePng(const Exporter* exporter, const ExportJob* job)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/frame_%06llu.png", job->index);
+	std::string path = exporter->path + name;
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+	bool ok = fwrite(job->encoded.data(), job->encoded.size(), 1, file) == 1;
+	return fclose(file) == 0 && ok;
+}
+
+// writes the y4m frames that are next in line, job is one that just finished
+static bool writeInOrder(Exporter* exporter, ExportJob* job, std::vector<ExportJob*>* written)
+{
+	std::lock_guard<std::mutex> guard(exporter->writeLock);
+	exporter->finished[job->index] = job;
+	bool ok = true;
+	while (!exporter->finished.empty() && exporter->finished.begin()->first == exporter->nextWrite)
+	{
+		ExportJob* next = exporter->finished.begin()->second;
+		exporter->finished.erase(exporter->finished.begin());
+		ok = fwrite(next->encoded.data(), next->encoded.size(), 1, exporter->stream) == 1 && ok;
+		exporter->nextWrite++;
+		written->push_back(next);
+	}
+	return ok;
+}
+
+static void workerThread(Exporter* exporter)
+{
+	std::vector<ExportJob*> written;
+	std::unique_lock<std::mutex> guard(exporter->lock);
+	for (;;)
+	{
+		exporter->wake.wait(guard, [exporter] { return exporter->stopping || !exporter->queue.empty(); });
+		if (exporter->queue.empty())
+		{
+			break;
+		}
+		ExportJob* job = exporter->queue.front();
+		exporter->queue.pop_front();
+		guard.unlock();
+
+		bool ok = true;
+		written.clear();
+		if (exporter->format == EXPORT_PNG)
+		{
+			encodePng(exporter, job);
+			ok = writePng(exporter, job);
+			written.push_back(job);
+		}
+		else
+		{
+			encodeY4m(exporter, job);
+			ok = writeInOrder(exporter, job, &written);
+		}
+
+		guard.lock();
+		if (!ok && !exporter->failed)
+		{
+			printf("failed to write the export %s\n", exporter->path.c_str());
+			exporter->failed = true;
+		}
+		for (size_t i = 0; i < written.size(); i++)
+		{
+			exporter->frames++;
+			exporter->bytes += written[i]->encoded.size();
+			exporter->spare.push_back(written[i]);
+			exporter->pending--;
+		}
+		exporter->done.notify_all();
+	}
+}
+
+static bool endsWith(const char* text, const char* suffix)
+{
+	size_t length = strlen(text);
+	size_t suffixLength = strlen(suffix);
+	return length >= suffixLength && strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+bool openExporter(Exporter* exporter, const char* path, u32 width, u32 height, u32 fps)
+{
+	exporter->path = path;
+	exporter->width = width;
+	exporter->height = height;
+	exporter->stream = NULL;
+	exporter->format = strcmp(path, "-") == 0 || endsWith(path, ".y4m") ? EXPORT_Y4M : EXPORT_PNG;
+	if (exporter->format == EXPORT_PNG)
+	{
+		if (!makeDirectory(path))
+		{
+			printf("failed to create the export directory %s\n", path);
+			return false;
+		}
+	}
+	else
+	{
+		exporter->stream = strcmp(path, "-") == 0 ? takeStdout() : fopen(path, "wb");
+		if (!exporter->stream)
+		{
+			printf("failed to open the export %s\n", path);
+			return false;
+		}
+		setvbuf(exporter->stream, NULL, _IOFBF, EXPORT_WRITE_BUFFER_SIZE);
+		fprintf(exporter->stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+	}
+
+	glGenBuffers(EXPORT_RING_SIZE, exporter->buffers);
+	for (u32 i = 0; i < EXPORT_RING_SIZE; i++)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, exporter->buffers[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+		exporter->fences[i] = NULL;
+		exporter->indices[i] = 0;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	exporter->oldest = 0;
+	exporter->reading = 0;
+	exporter->nextIndex = 0;
+
+	// the renderer and the simulation have a core each
+	u32 threads = std::thread::hardware_concurrency();
+	threads = threads > 2 ? threads - 2 : 1;
+	threads = threads < EXPORT_MAX_WORKERS ? threads : EXPORT_MAX_WORKERS;
+	exporter->queue.clear();
+	exporter->spare.clear();
+	exporter->finished.clear();
+	exporter->pending = 0;
+	exporter->maxPending = threads * EXPORT_FRAMES_PER_WORKER;
+	exporter->stopping = false;
+	exporter->failed = false;
+	exporter->nextWrite = 0;
+	exporter->frames = 0;
+	exporter->bytes = 0;
+	exporter->readbackStalls = 0;
+	exporter->encodeStalls = 0;
+	exporter->workers.clear();
+	for (u32 i = 0; i < threads; i++)
+	{
+		exporter->workers.push_back(std::thread(workerThread, exporter));
+	}
+	return true;
+}
+
+// maps the oldest readback and hands it to the encoders, waiting for its
+// fence only when wait is set
+static bool takeReadback(Exporter* exporter, bool wait)
+{
+	u32 slot = exporter->oldest;
+	GLsync fence = exporter->fences[slot];
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		if (!wait)
+		{
+			return false;
+		}
+		exporter->readbackStalls++;
+		while (status == GL_TIMEOUT_EXPIRED)
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, EXPORT_WAIT_NANOSECONDS);
+		}
+	}
+	glDeleteSync(fence);
+	exporter->fences[slot] = NULL;
+	exporter->oldest = (slot + 1) % EXPORT_RING_SIZE;
+	exporter->reading--;
+
+	ExportJob* job = NULL;
+	{
+		std::unique_lock<std::mutex> guard(exporter->lock);
+		if (exporter->pending >= exporter->maxPending)
+		{
+			exporter->encodeStalls++;
+			exporter->done.wait(guard, [exporter] { return exporter->pending < exporter->maxPending; });
+		}
+		if (!exporter->spare.empty())
+		{
+			job = exporter->spare.back();
+			exporter->spare.pop_back();
+		}
+		exporter->pending++;
+	}
+	if (!job)
+	{
+		job = new ExportJob();
+	}
+
+	size_t size = (size_t)exporter->width * exporter->height * 4;
+	job->index = exporter->indices[slot];
+	job->pixels.resize(size);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, exporter->buffers[slot]);
+	const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+	if (mapped)
+	{
+		memcpy(job->pixels.data(), mapped, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	else
+	{
+		// keeps the frame count of a video right
+		memset(job->pixels.data(), 0, size);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	{
+		std::lock_guard<std::mutex> guard(exporter->lock);
+		exporter->queue.push_back(job);
+	}
+	exporter->wake.notify_one();
+	return true;
+}
+
+void closeExporter(Exporter* exporter)
+{
+	while (exporter->reading)
+	{
+		takeReadback(exporter, true);
+	}
+	{
+		std::lock_guard<std::mutex> guard(exporter->lock);
+		exporter->stopping = true;
+	}
+	exporter->wake.notify_all();
+	for (size_t i = 0; i < exporter->workers.size(); i++)
+	{
+		exporter->workers[i].join();
+	}
+	exporter->workers.clear();
+	for (size_t i = 0; i < exporter->spare.size(); i++)
+	{
+		delete exporter->spare[i];
+	}
+	exporter->spare.clear();
+
+	if (exporter->stream && fclose(exporter->stream) != 0 && !exporter->failed)
+	{
+		printf("failed to write the export %s\n", exporter->path.c_str());
+		exporter->failed = true;
+	}
+	exporter->stream = NULL;
+	glDeleteBuffers(EXPORT_RING_SIZE, exporter->buffers);
+}
+
+void finishExportFrame(Exporter* exporter, u32 framebuffer, bool capture)
+{
+	// whatever finished reading back goes to the encoders, and a full ring
+	// waits on its oldest to make room
+	while (exporter->reading && takeReadback(exporter, capture && exporter->reading == EXPORT_RING_SIZE))
+	{
+	}
+	if (capture)
+	{
+		u32 slot = (exporter->oldest + exporter->reading) % EXPORT_RING_SIZE;
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, exporter->buffers[slot]);
+		glReadPixels(0, 0, exporter->width, exporter->height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		exporter->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		exporter->indices[slot] = exporter->nextIndex++;
+		exporter->reading++;
+	}
+}
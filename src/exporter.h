@@ -0,0 +1,91 @@
+#pragma once
+
+#include "common.h"
+#include "glext.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// writes the drawn frames out as a png sequence or a y4m video. frames are
+// read back from the renderer's framebuffer into a ring of pixel pack
+// buffers with a fence each. a buffer is only mapped once its fence signalled, a few
+// frames later, so the readback never waits on the draw. the pixels are then
+// encoded on a pool of threads. pngs are written by whichever thread encoded
+// them, y4m frames are put back in order before they're written.
+//
+// a path ending in .y4m is a video file, - is a video on stdout and anything
+// else is a directory of frame_000000.png files.
+static const u32 EXPORT_RING_SIZE = 4;
+static const u32 EXPORT_MAX_WORKERS = 8;
+// frames handed to the encoders per worker before the renderer waits on them
+static const u32 EXPORT_FRAMES_PER_WORKER = 2;
+
+enum ExportFormat
+{
+	EXPORT_PNG,
+	EXPORT_Y4M,
+};
+
+struct ExportJob
+{
+	u64 index;
+	// bottom up rgba, as gl reads it
+	std::vector<u8> pixels;
+	// png scanlines before they're compressed
+	std::vector<u8> rows;
+	std::vector<u8> encoded;
+};
+
+struct Exporter
+{
+	ExportFormat format;
+	std::string path;
+	u32 width;
+	u32 height;
+	FILE* stream;
+
+	u32 buffers[EXPORT_RING_SIZE];
+	GLsync fences[EXPORT_RING_SIZE];
+	u64 indices[EXPORT_RING_SIZE];
+	// the oldest buffer still being read back, and how many are
+	u32 oldest;
+	u32 reading;
+	u64 nextIndex;
+
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::deque<ExportJob*> queue;
+	std::vector<ExportJob*> spare;
+	// jobs taken from spare that haven't been given back
+	u32 pending;
+	u32 maxPending;
+	bool stopping;
+	bool failed;
+
+	// y4m frames that were encoded ahead of the next one to be written
+	std::mutex writeLock;
+	std::map<u64, ExportJob*> finished;
+	u64 nextWrite;
+
+	u64 frames;
+	u64 bytes;
+	// readbacks that had to wait on the gpu, and frames that waited on the encoders
+	u64 readbackStalls;
+	u64 encodeStalls;
+};
+
+// fps only goes into the y4m header. needs a current context.
+bool openExporter(Exporter* exporter, const char* path, u32 width, u32 height, u32 fps);
+// reads back what's in flight, then waits for the encoders
+void closeExporter(Exporter* exporter);
+
+// starts reading the frame in framebuffer back when captured, and hands
+// frames whose readback finished to the encoders. call every frame.
+void finishExportFrame(Exporter* exporter, u32 framebuffer, bool capture);
@@ -0,0 +1,51 @@
+#include "glext.h"
+#include <string.h>
+
+PFNLGCVERTEXATTRIBDIVISORPROC lgcVertexAttribDivisor = NULL;
+PFNLGCGETPROGRAMBINARYPROC lgcGetProgramBinary = NULL;
+PFNLGCPROGRAMBINARYPROC lgcProgramBinary = NULL;
+PFNLGCPROGRAMPARAMETERIPROC lgcProgramParameteri = NULL;
+PFNLGCMAXSHADERCOMPILERTHREADSPROC lgcMaxShaderCompilerThreads = NULL;
+PFNLGCDEBUGMESSAGECALLBACKPROC lgcDebugMessageCallback = NULL;
+PFNLGCDEBUGMESSAGECONTROLPROC lgcDebugMessageControl = NULL;
+PFNLGCDISPATCHCOMPUTEPROC lgcDispatchCompute = NULL;
+PFNLGCMEMORYBARRIERPROC lgcMemoryBarrier = NULL;
+PFNLGCBUFFERSTORAGEPROC lgcBufferStorage = NULL;
+
+void loadGLExtensions(GLADloadproc load)
+{
+	lgcVertexAttribDivisor = (PFNLGCVERTEXATTRIBDIVISORPROC)load("glVertexAttribDivisor");
+	lgcGetProgramBinary = (PFNLGCGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+	lgcProgramBinary = (PFNLGCPROGRAMBINARYPROC)load("glProgramBinary");
+	lgcProgramParameteri = (PFNLGCPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+	lgcMaxShaderCompilerThreads = (PFNLGCMAXSHADERCOMPILERTHREADSPROC)load("glMaxShaderCompilerThreadsKHR");
+	if (!lgcMaxShaderCompilerThreads)
+	{
+		lgcMaxShaderCompilerThreads = (PFNLGCMAXSHADERCOMPILERTHREADSPROC)load("glMaxShaderCompilerThreadsARB");
+	}
+	lgcDebugMessageCallback = (PFNLGCDEBUGMESSAGECALLBACKPROC)load("glDebugMessageCallback");
+	lgcDebugMessageControl = (PFNLGCDEBUGMESSAGECONTROLPROC)load("glDebugMessageControl");
+	lgcDispatchCompute = (PFNLGCDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+	lgcMemoryBarrier = (PFNLGCMEMORYBARRIERPROC)load("glMemoryBarrier");
+	lgcBufferStorage = (PFNLGCBUFFERSTORAGEPROC)load("glBufferStorage");
+}
+
+bool hasGLVersion(int major, int minor)
+{
+	return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+}
+
+bool hasGLExtension(const char* name)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && strcmp(extension, name) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// entry points and enums past the gl 3.2 that glad was generated for. they
+// are loaded by loadGLExtensions after the context is made current and are
+// NULL when the driver doesn't have them, check the version or extension first.
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_VERSION_4_3
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#define GL_ALL_BARRIER_BITS 0xFFFFFFFF
+#endif
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+
+// KHR_parallel_shader_compile, and the ARB extension with the same enums
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP PFNLGCVERTEXATTRIBDIVISORPROC)(GLuint index, GLuint divisor);
+typedef void (APIENTRYP PFNLGCGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* format, void* binary);
+typedef void (APIENTRYP PFNLGCPROGRAMBINARYPROC)(GLuint program, GLenum format, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNLGCPROGRAMPARAMETERIPROC)(GLuint program, GLenum name, GLint value);
+typedef void (APIENTRYP PFNLGCMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+typedef void (APIENTRYP PFNLGCDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void* userParam);
+typedef void (APIENTRYP PFNLGCDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint* ids, GLboolean enabled);
+typedef void (APIENTRYP PFNLGCDISPATCHCOMPUTEPROC)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFNLGCMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNLGCBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+extern PFNLGCVERTEXATTRIBDIVISORPROC lgcVertexAttribDivisor;
+extern PFNLGCGETPROGRAMBINARYPROC lgcGetProgramBinary;
+extern PFNLGCPROGRAMBINARYPROC lgcProgramBinary;
+extern PFNLGCPROGRAMPARAMETERIPROC lgcProgramParameteri;
+extern PFNLGCMAXSHADERCOMPILERTHREADSPROC lgcMaxShaderCompilerThreads;
+extern PFNLGCDEBUGMESSAGECALLBACKPROC lgcDebugMessageCallback;
+extern PFNLGCDEBUGMESSAGECONTROLPROC lgcDebugMessageControl;
+extern PFNLGCDISPATCHCOMPUTEPROC lgcDispatchCompute;
+extern PFNLGCMEMORYBARRIERPROC lgcMemoryBarrier;
+extern PFNLGCBUFFERSTORAGEPROC lgcBufferStorage;
+#define glVertexAttribDivisor lgcVertexAttribDivisor
+#define glGetProgramBinary lgcGetProgramBinary
+#define glProgramBinary lgcProgramBinary
+#define glProgramParameteri lgcProgramParameteri
+#define glMaxShaderCompilerThreads lgcMaxShaderCompilerThreads
+#define glDebugMessageCallback lgcDebugMessageCallback
+#define glDebugMessageControl lgcDebugMessageControl
+#define glDispatchCompute lgcDispatchCompute
+#define glMemoryBarrier lgcMemoryBarrier
+#define glBufferStorage lgcBufferStorage
+
+void loadGLExtensions(GLADloadproc load);
+bool hasGLVersion(int major, int minor);
+bool hasGLExtension(const char* name);
@@ -0,0 +1,189 @@
+#include "gpulife.h"
+#include "glext.h"
+#include <stdio.h>
+#include <string.h>
+
+// same rule as stepLife with the bit sliced counter of the tiled engine. a
+// group stages its words plus a one word halo in shared memory, every
+// invocation then computes one word of 32 cells.
+static const char rawStepCode[] =
+R"END(
+	#version 430
+	layout(local_size_x = %u, local_size_y = %u) in;
+
+	const int width = %u;
+	const int height = %u;
+	const int rowWords = %u;
+	const int tileWords = int(gl_WorkGroupSize.x) + 2;
+	const int tileRows = int(gl_WorkGroupSize.y) + 2;
+	layout(std430, binding = 0) readonly buffer Current { uint words[]; } current;
+	layout(std430, binding = 1) writeonly buffer Next { uint words[]; } next;
+
+	shared uint tile[tileRows][tileWords];
+
+	void add(inout uint s0, inout uint s1, inout uint s2, uint bits)
+	{
+		uint carry0 = s0 & bits;
+		s0 ^= bits;
+		uint carry1 = s1 & carry0;
+		s1 ^= carry0;
+		s2 |= carry1;
+	}
+
+	void main()
+	{
+		ivec2 origin = ivec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy) - 1;
+		uint groupSize = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+		for (uint i = gl_LocalInvocationIndex; i < uint(tileWords * tileRows); i += groupSize)
+		{
+			ivec2 source = origin + ivec2(int(i) %% tileWords, int(i) / tileWords);
+			bool inside = source.x >= 0 && source.y >= 0 && source.x < rowWords && source.y < height;
+			tile[int(i) / tileWords][int(i) %% tileWords] = inside ? current.words[source.x + source.y * rowWords] : 0u;
+		}
+		barrier();
+
+		ivec2 word = ivec2(gl_GlobalInvocationID.xy);
+		if (word.x >= rowWords || word.y >= height)
+		{
+			return;
+		}
+
+		ivec2 local = ivec2(gl_LocalInvocationID.xy) + 1;
+		uint s0 = 0u;
+		uint s1 = 0u;
+		uint s2 = 0u;
+		for (int r = -1; r <= 1; r++)
+		{
+			uint centre = tile[local.y + r][local.x];
+			add(s0, s1, s2, (centre << 1) | (tile[local.y + r][local.x - 1] >> 31));
+			add(s0, s1, s2, (centre >> 1) | (tile[local.y + r][local.x + 1] << 31));
+			if (r != 0)
+			{
+				add(s0, s1, s2, centre);
+			}
+		}
+
+		// the border stays dead
+		int first = word.x * 32;
+		int start = clamp(1 - first, 0, 32);
+		int stop = clamp(width - 1 - first, 0, 32);
+		uint mask = stop <= start ? 0u : (stop == 32 ? 0xffffffffu : (1u << stop) - 1u) & ~((1u << start) - 1u);
+		if (word.y == 0 || word.y >= height - 1)
+		{
+			mask = 0u;
+		}
+		next.words[word.x + word.y * rowWords] = s1 & ~s2 & mask;
+	}
+)END";
+
+bool gpuLifeSupported()
+{
+	return hasGLVersion(4, 3) && glDispatchCompute && glMemoryBarrier;
+}
+
+bool initGpuLife(GpuLife* gpu, const Life* life, ProgramCache* cache)
+{
+	u32 rowWords = gpuRowWords(life->width);
+	char code[sizeof(rawStepCode) + 64];
+	snprintf(code, sizeof(code), rawStepCode, GPU_GROUP_WORDS, GPU_GROUP_ROWS, life->width, life->height, rowWords);
+	PendingProgram pending;
+	beginComputeProgram(cache, &pending, code);
+	gpu->program = finishProgram(cache, &pending);
+	if (!gpu->program)
+	{
+		return false;
+	}
+
+	gpu->width = life->width;
+	gpu->height = life->height;
+	gpu->rowWords = rowWords;
+	gpu->current = life->current;
+	gpu->generation = life->generation;
+	gpu->groupsX = (rowWords + GPU_GROUP_WORDS - 1) / GPU_GROUP_WORDS;
+	gpu->groupsY = (life->height + GPU_GROUP_ROWS - 1) / GPU_GROUP_ROWS;
+	gpu->uploadedBytes = 0;
+	gpu->readbackBytes = 0;
+
+	GLsizeiptr size = (GLsizeiptr)rowWords * life->height * sizeof(u32);
+	glGenBuffers(NUM_CELL_BUFFERS, gpu->buffers);
+	glGenTextures(NUM_CELL_BUFFERS, gpu->textures);
+	for (u32 i = 0; i < NUM_CELL_BUFFERS; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, gpu->buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+		glBindTexture(GL_TEXTURE_BUFFER, gpu->textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, gpu->buffers[i]);
+	}
+	uploadGpuLife(gpu, life);
+	return true;
+}
+
+void destroyGpuLife(GpuLife* gpu)
+{
+	glDeleteTextures(NUM_CELL_BUFFERS, gpu->textures);
+	glDeleteBuffers(NUM_CELL_BUFFERS, gpu->buffers);
+	glDeleteProgram(gpu->program);
+	gpu->program = 0;
+}
+
+void stepGpuLife(GpuLife* gpu)
+{
+	u32 next = (gpu->current + 1) % NUM_CELL_BUFFERS;
+	glUseProgram(gpu->program);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gpu->buffers[gpu->current]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, gpu->buffers[next]);
+	glDispatchCompute(gpu->groupsX, gpu->groupsY, 1);
+	// the next step reads it as storage, the renderer as a texture buffer and
+	// readbacks through the buffer api
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	gpu->current = next;
+	gpu->generation++;
+}
+
+// replaces packed words of the current generation, row y starts at word y * rowWords
+static void writeGpuWords(GpuLife* gpu, u64 first, u32 count, const u32* words)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpu->buffers[gpu->current]);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)(first * sizeof(u32)), (GLsizeiptr)count * sizeof(u32), words);
+	gpu->uploadedBytes += (u64)count * sizeof(u32);
+}
+
+void uploadGpuLife(GpuLife* gpu, const Life* life)
+{
+	const u32* ages = currentAges(life);
+	gpu->packed.assign((size_t)gpu->rowWords * gpu->height, 0);
+	for (u32 y = 0; y < gpu->height; y++)
+	{
+		u32* row = gpu->packed.data() + (size_t)y * gpu->rowWords;
+		const u32* cells = ages + (size_t)y * gpu->width;
+		for (u32 x = 0; x < gpu->width; x++)
+		{
+			row[x / 32] |= (cells[x] != 0 ? 1u : 0u) << (x % 32);
+		}
+	}
+	writeGpuWords(gpu, 0, (u32)gpu->packed.size(), gpu->packed.data());
+	gpu->generation = life->generation;
+}
+
+void readGpuLife(GpuLife* gpu, Life* life)
+{
+	gpu->packed.resize((size_t)gpu->rowWords * gpu->height);
+	GLsizeiptr size = (GLsizeiptr)gpu->packed.size() * sizeof(u32);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gpu->buffers[gpu->current]);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, gpu->packed.data());
+	gpu->readbackBytes += (u64)size;
+
+	u32 next = (life->current + 1) % NUM_CELL_BUFFERS;
+	u32* ages = life->ages[next].data();
+	for (u32 y = 0; y < gpu->height; y++)
+	{
+		const u32* row = gpu->packed.data() + (size_t)y * gpu->rowWords;
+		u32* cells = ages + (size_t)y * gpu->width;
+		for (u32 x = 0; x < gpu->width; x++)
+		{
+			cells[x] = (row[x / 32] >> (x % 32)) & 1;
+		}
+	}
+	life->current = next;
+	life->generation = gpu->generation;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "common.h"
+#include "life.h"
+#include "programs.h"
+#include <vector>
+
+// steps the board on the device with a compute shader. cells are packed 32
+// to a uint, cell x of a row is bit x % 32 of word x / 32 and every row
+// starts on a new word. the two packed buffers ping-pong like the host
+// buffers in Life and are drawn straight from a texture buffer, so a
+// generation never leaves the device unless it is read back. ages aren't
+// kept, every live cell is 1 on the way back.
+static const u32 GPU_GROUP_WORDS = 8;
+static const u32 GPU_GROUP_ROWS = 8;
+// dispatches queued per drawn frame when the rate asks for more
+static const u32 MAX_GPU_GENERATIONS_PER_FRAME = 64;
+
+struct GpuLife
+{
+	u32 width;
+	u32 height;
+	u32 rowWords;
+	u32 buffers[NUM_CELL_BUFFERS];
+	// R32UI views of the buffers for the renderer
+	u32 textures[NUM_CELL_BUFFERS];
+	u32 current;
+	u64 generation;
+
+	u32 program;
+	u32 groupsX;
+	u32 groupsY;
+	std::vector<u32> packed;
+
+	u64 uploadedBytes;
+	u64 readbackBytes;
+};
+
+inline u32 gpuRowWords(u32 width)
+{
+	return (width + 31) / 32;
+}
+
+// needs gl 4.3 and loadGLExtensions
+bool gpuLifeSupported();
+// creates the device buffers and uploads the board
+bool initGpuLife(GpuLife* gpu, const Life* life, ProgramCache* cache);
+void destroyGpuLife(GpuLife* gpu);
+
+void stepGpuLife(GpuLife* gpu);
+// replaces the current generation with the board
+void uploadGpuLife(GpuLife* gpu, const Life* life);
+// copies the current generation into the next host buffer of life and makes
+// it current, like stepLife would have
+void readGpuLife(GpuLife* gpu, Life* life);
+
+inline u32 gpuTexture(const GpuLife* gpu)
+{
+	return gpu->textures[gpu->current];
+}
@@ -0,0 +1,222 @@
+#include "headless.h"
+#include "checkpoint.h"
+#include "gpulife.h"
+#include "life.h"
+#include "options.h"
+#include "patterns.h"
+#include "recording.h"
+#include "simulation.h"
+#include "tiled.h"
+#include <chrono>
+#include <stdio.h>
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void writeStats(FILE* file, Life* life, TiledLife* tiled, GpuLife* gpu, double seconds)
+{
+	if (tiled)
+	{
+		// births and deaths would need the previous plane compared tile by tile
+		fprintf(file, "%llu,%llu,,,%.3f\n", life->generation, tiledPopulation(tiled), seconds);
+	}
+	else if (gpu)
+	{
+		// only the current generation comes back from the device, see readBack
+		fprintf(file, "%llu,%llu,,,%.3f\n", life->generation, measureLife(life).population, seconds);
+	}
+	else
+	{
+		LifeStats stats = measureLife(life);
+		fprintf(file, "%llu,%llu,%llu,%llu,%.3f\n", life->generation, stats.population, stats.births, stats.deaths, seconds);
+	}
+}
+
+// checked every generation, so neither looks at the whole board
+static bool stopReached(StopCondition condition, Life* life, TiledLife* tiled)
+{
+	switch (condition)
+	{
+		case STOP_EXTINCT:
+		{
+			return tiled ? tiledExtinct(tiled) : lifeExtinct(life);
+		}
+		case STOP_STILL:
+		{
+			return lifeStill(life);
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+// brings the host board up to the device's generation
+static void readBack(GpuLife* gpu, Life* life, Checkpointer* checkpointer)
+{
+	// a checkpoint still writing may be reading the buffer it lands in
+	if (checkpointer)
+	{
+		protectCheckpoint(checkpointer, life->ages[(life->current + 1) % NUM_CELL_BUFFERS].data());
+	}
+	readGpuLife(gpu, life);
+}
+
+// steps a host copy of the starting board as far as the device went and
+// compares which cells are alive
+static bool checkGpuRun(Life* reference, const Life* life)
+{
+	u64 generations = life->generation - reference->generation;
+	for (u64 i = 0; i < generations; i++)
+	{
+		stepLife(reference);
+	}
+	const u32* expected = currentAges(reference);
+	const u32* ages = currentAges(life);
+	u64 differences = 0;
+	for (u32 i = 0; i < cellCount(life); i++)
+	{
+		differences += (expected[i] != 0) != (ages[i] != 0);
+	}
+	if (differences)
+	{
+		printf("gpu check failed: %llu cells differ from the host after %llu generations\n", differences, generations);
+		return false;
+	}
+	printf("gpu check passed after %llu generations\n", generations);
+	return true;
+}
+
+int runHeadless(const Options* options, Life* life, TiledLife* tiled, GpuLife* gpu)
+{
+	FILE* statsFile = NULL;
+	if (options->statsPath)
+	{
+		statsFile = fopen(options->statsPath, "wb");
+		if (!statsFile)
+		{
+			printf("failed to open %s\n", options->statsPath);
+			if (tiled)
+			{
+				closeTiledLife(tiled);
+			}
+			return 1;
+		}
+		fprintf(statsFile, "generation,population,births,deaths,seconds\n");
+	}
+
+	Recorder recorder;
+	bool recording = options->recordPath != NULL;
+	if (recording)
+	{
+		if (!openRecorder(&recorder, options->recordPath, life, options->keyframeInterval))
+		{
+			if (statsFile)
+			{
+				fclose(statsFile);
+			}
+			return 1;
+		}
+		recordGeneration(&recorder, life);
+	}
+
+	Checkpointer checkpointer;
+	bool checkpointing = options->checkpointPath != NULL;
+	if (checkpointing)
+	{
+		startCheckpointer(&checkpointer, options->checkpointPath);
+	}
+
+	Simulation simulation;
+	initSimulation(&simulation, life);
+	simulation.tiled = tiled;
+	simulation.gpu = gpu;
+	simulation.recorder = recording ? &recorder : NULL;
+	simulation.checkpointer = checkpointing ? &checkpointer : NULL;
+	simulation.checkpointInterval = options->checkpointInterval ? options->checkpointInterval : DEFAULT_CHECKPOINT_INTERVAL;
+
+	Life reference;
+	if (options->checkGpu)
+	{
+		reference = *life;
+	}
+
+	u32 statsInterval = options->statsInterval ? options->statsInterval : DEFAULT_STATS_INTERVAL;
+	u64 firstGeneration = life->generation;
+	u64 lastStats = life->generation;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (statsFile)
+	{
+		writeStats(statsFile, life, tiled, gpu, 0.0);
+	}
+
+	// the buffer behind a restored or loaded board isn't its previous
+	// generation, so conditions are only checked once something was stepped
+	bool stopped = false;
+	while (!stopped && (options->generations == 0 || life->generation - firstGeneration < options->generations))
+	{
+		stepSimulation(&simulation);
+		stopped = stopReached(options->stopCondition, life, tiled);
+		if (statsFile && (stopped || life->generation - lastStats >= statsInterval))
+		{
+			if (gpu)
+			{
+				readBack(gpu, life, simulation.checkpointer);
+			}
+			writeStats(statsFile, life, tiled, gpu, secondsSince(start));
+			lastStats = life->generation;
+		}
+	}
+
+	if (gpu)
+	{
+		// the dispatches are only queued, reading the board back waits for them
+		readBack(gpu, life, simulation.checkpointer);
+	}
+	double seconds = secondsSince(start);
+	u64 generations = life->generation - firstGeneration;
+	printf("ran %llu generations in %.3fs, %.1f generations/s%s\n",
+		   generations, seconds, seconds > 0.0 ? generations / seconds : 0.0, stopped ? ", stop condition reached" : "");
+
+	bool ok = true;
+	if (statsFile)
+	{
+		if (lastStats != life->generation)
+		{
+			writeStats(statsFile, life, tiled, gpu, seconds);
+		}
+		ok = !ferror(statsFile);
+		ok = fclose(statsFile) == 0 && ok;
+		if (!ok)
+		{
+			printf("failed to write %s\n", options->statsPath);
+		}
+	}
+	if (options->checkGpu)
+	{
+		ok = checkGpuRun(&reference, life) && ok;
+	}
+	if (recording)
+	{
+		closeRecorder(&recorder);
+		printf("recording: %llu generations waited on the writer\n", recorder.stalls);
+	}
+	if (tiled)
+	{
+		closeTiledLife(tiled);
+	}
+	if (options->savePath)
+	{
+		ok = savePattern(options->savePath, life) && ok;
+	}
+	if (checkpointing)
+	{
+		waitForCheckpoint(&checkpointer);
+		beginCheckpoint(&checkpointer, life);
+		stopCheckpointer(&checkpointer);
+	}
+	return ok ? 0 : 1;
+}
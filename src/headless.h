@@ -0,0 +1,17 @@
+#pragma once
+
+#include "common.h"
+
+struct GpuLife;
+struct Life;
+struct Options;
+struct TiledLife;
+
+static const u32 DEFAULT_STATS_INTERVAL = 100;
+
+// runs the board on this thread without a window until the generation count
+// or stop condition in the options is reached, then writes the final state.
+// tiled is NULL unless the board is tiled, it is closed when done. gpu is
+// NULL unless the board steps on the device, which needs the caller's
+// context current. returns the process exit code.
+int runHeadless(const Options* options, Life* life, TiledLife* tiled, GpuLife* gpu);
@@ -0,0 +1,169 @@
+#include "life.h"
+#include <assert.h>
+#include <string.h>
+
+void initLife(Life* life, u32 width, u32 height)
+{
+	assert(width >= 3 && height >= 3);
+	life->width = width;
+	life->height = height;
+	life->current = 0;
+	life->generation = 0;
+	for (u32 i = 0; i < NUM_CELL_BUFFERS; i++)
+	{
+		life->ages[i].assign((size_t)width * height, 0);
+	}
+	life->dirtyColumns = (width + DIRTY_TILE_WIDTH - 1) / DIRTY_TILE_WIDTH;
+	life->dirtyTiles.assign(dirtyTileCount(width, height), TILE_LIVE | TILE_CHANGED);
+}
+
+void stepLife(Life* life)
+{
+	u32 nextCellBufferIndex = (life->current + 1) % NUM_CELL_BUFFERS;
+	const u32* cellBuffer = life->ages[life->current].data();
+	u32* nextCellBuffer = life->ages[nextCellBufferIndex].data();
+	const u32 width = life->width;
+	const u32 height = life->height;
+
+	// the border is never simulated, keep it dead in both buffers
+	memset(nextCellBuffer, 0, width * sizeof(u32));
+	memset(nextCellBuffer + (height - 1) * width, 0, width * sizeof(u32));
+	for (u32 j = 1; j < height - 1; j++)
+	{
+		nextCellBuffer[j * width] = 0;
+		nextCellBuffer[j * width + width - 1] = 0;
+	}
+	memset(life->dirtyTiles.data(), 0, life->dirtyTiles.size());
+
+	for (u32 j = 1; j < height - 1; j++)
+	{
+		u8* dirtyRow = life->dirtyTiles.data() + (j / DIRTY_TILE_HEIGHT) * life->dirtyColumns;
+		u32 activity = 0;
+		bool changed = false;
+		for (u32 i = 1; i < width - 1; i++)
+		{
+			const u32* above = cellBuffer + (j + 1) * width;
+			const u32* row = cellBuffer + j * width;
+			const u32* below = cellBuffer + (j - 1) * width;
+
+			u32 numAliveNeighbours = 0;
+
+			// top row
+			numAliveNeighbours += above[i - 1] ? 1 : 0;
+			numAliveNeighbours += above[i] ? 1 : 0;
+			numAliveNeighbours += above[i + 1] ? 1 : 0;
+
+			// middle row
+			numAliveNeighbours += row[i - 1] ? 1 : 0;
+			numAliveNeighbours += row[i + 1] ? 1 : 0;
+
+			// bottom row
+			numAliveNeighbours += below[i - 1] ? 1 : 0;
+			numAliveNeighbours += below[i] ? 1 : 0;
+			numAliveNeighbours += below[i + 1] ? 1 : 0;
+
+			u32* nextCell = &nextCellBuffer[i + j * width];
+			switch (numAliveNeighbours)
+			{
+				case 0:
+				case 1:
+				{
+					*nextCell = 0;
+				} break;
+				case 2:
+				case 3:
+				{
+					if (row[i])
+					{
+						*nextCell = row[i] + 1;
+					}
+					else
+					{
+						*nextCell = 1;
+					}
+				} break;
+				default:
+				{
+					*nextCell = 0;
+				}
+			}
+
+			// flag the tile at the end of each tile column if anything was alive in it
+			activity |= *nextCell | row[i];
+			changed |= (*nextCell == 0) != (row[i] == 0);
+			if ((i + 1) % DIRTY_TILE_WIDTH == 0 || i == width - 2)
+			{
+				dirtyRow[i / DIRTY_TILE_WIDTH] |= (activity ? TILE_LIVE : 0) | (changed ? TILE_CHANGED : 0);
+				activity = 0;
+				changed = false;
+			}
+		}
+	}
+
+	life->current = nextCellBufferIndex;
+	life->generation++;
+}
+
+LifeStats measureLife(const Life* life)
+{
+	const u32* ages = life->ages[life->current].data();
+	const u32* previous = life->ages[(life->current + 1) % NUM_CELL_BUFFERS].data();
+	LifeStats stats = {};
+	for (u32 i = 0; i < cellCount(life); i++)
+	{
+		// a cell of age 1 was just born
+		stats.population += ages[i] != 0;
+		stats.births += ages[i] == 1;
+		stats.deaths += ages[i] == 0 && previous[i] != 0;
+	}
+	return stats;
+}
+
+bool lifeStill(const Life* life)
+{
+	for (size_t i = 0; i < life->dirtyTiles.size(); i++)
+	{
+		if (life->dirtyTiles[i] & TILE_CHANGED)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool lifeExtinct(const Life* life)
+{
+	// a live tile where nothing was born or died kept its live cells
+	for (size_t i = 0; i < life->dirtyTiles.size(); i++)
+	{
+		if (life->dirtyTiles[i] == TILE_LIVE)
+		{
+			return false;
+		}
+	}
+
+	const u32* ages = currentAges(life);
+	for (size_t i = 0; i < life->dirtyTiles.size(); i++)
+	{
+		if (!(life->dirtyTiles[i] & TILE_CHANGED))
+		{
+			continue;
+		}
+		u32 x0 = (u32)(i % life->dirtyColumns) * DIRTY_TILE_WIDTH;
+		u32 y0 = (u32)(i / life->dirtyColumns) * DIRTY_TILE_HEIGHT;
+		u32 x1 = x0 + DIRTY_TILE_WIDTH < life->width ? x0 + DIRTY_TILE_WIDTH : life->width;
+		u32 y1 = y0 + DIRTY_TILE_HEIGHT < life->height ? y0 + DIRTY_TILE_HEIGHT : life->height;
+		for (u32 y = y0; y < y1; y++)
+		{
+			const u32* row = ages + (size_t)y * life->width;
+			for (u32 x = x0; x < x1; x++)
+			{
+				if (row[x])
+				{
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
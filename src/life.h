@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common.h"
+#include <vector>
+
+static const u32 NUM_CELL_BUFFERS = 2;
+// the board is split into tiles that are flagged when a step may have changed them
+static const u32 DIRTY_TILE_WIDTH = 64;
+static const u32 DIRTY_TILE_HEIGHT = 16;
+// bits of a tile's flags, a changed tile is always live too
+static const u8 TILE_LIVE = 0x1;
+static const u8 TILE_CHANGED = 0x2;
+
+// every cell stores its age in generations, 0 means the cell is dead.
+// cells are stored row major, x + y * width.
+struct Life
+{
+	u32 width;
+	u32 height;
+	u32 current;
+	u64 generation;
+	std::vector<u32> ages[NUM_CELL_BUFFERS];
+
+	// one byte per tile, TILE_LIVE set by the last step for tiles that had a
+	// live cell before or after it and TILE_CHANGED where a cell was born or
+	// died. every tile is both after initLife.
+	u32 dirtyColumns;
+	std::vector<u8> dirtyTiles;
+};
+
+struct LifeStats
+{
+	u64 population;
+	u64 births;
+	u64 deaths;
+};
+
+void initLife(Life* life, u32 width, u32 height);
+void stepLife(Life* life);
+// compares the current generation with the one before it, still in the other buffer
+LifeStats measureLife(const Life* life);
+// read off the last step's dirtyTiles instead of a pass over the board.
+// still means no cell was born or died in the step.
+bool lifeStill(const Life* life);
+// only the tiles where a cell died are looked at, and only until a live cell turns up
+bool lifeExtinct(const Life* life);
+
+inline u32* currentAges(Life* life)
+{
+	return life->ages[life->current].data();
+}
+
+inline const u32* currentAges(const Life* life)
+{
+	return life->ages[life->current].data();
+}
+
+inline u32 cellCount(const Life* life)
+{
+	return life->width * life->height;
+}
+
+inline u32 dirtyTileCount(u32 width, u32 height)
+{
+	return ((width + DIRTY_TILE_WIDTH - 1) / DIRTY_TILE_WIDTH) * ((height + DIRTY_TILE_HEIGHT - 1) / DIRTY_TILE_HEIGHT);
+}
@@ -0,0 +1,206 @@
+#include "macrocell.h"
+#include "platform.h"
+#include "quadtree.h"
+#include <stdio.h>
+#include <string.h>
+
+static const u32 MAX_QUAD_LEVEL = 62;
+
+bool isMacrocell(const u8* data, u64 size)
+{
+	return size >= 4 && memcmp(data, "[M2]", 4) == 0;
+}
+
+static bool parseLeaf(const char* line, const char* end, u64* bits)
+{
+	u64 row = 0;
+	u64 column = 0;
+	*bits = 0;
+	for (const char* c = line; c != end && *c != '\n' && *c != '\r'; c++)
+	{
+		if (*c == '$')
+		{
+			row++;
+			column = 0;
+			continue;
+		}
+		if ((*c != '.' && *c != '*') || row >= 8 || column >= 8)
+		{
+			return false;
+		}
+		if (*c == '*')
+		{
+			*bits |= 1ull << (column + row * 8);
+		}
+		column++;
+	}
+	return true;
+}
+
+static bool parseNumber(const char** cursor, const char* end, u32* value)
+{
+	const char* c = *cursor;
+	while (c != end && *c == ' ')
+	{
+		c++;
+	}
+	if (c == end || *c < '0' || *c > '9')
+	{
+		return false;
+	}
+	u64 result = 0;
+	while (c != end && *c >= '0' && *c <= '9' && result <= 0xffffffff)
+	{
+		result = result * 10 + (*c - '0');
+		c++;
+	}
+	*value = (u32)result;
+	*cursor = c;
+	return result <= 0xffffffff;
+}
+
+bool loadMacrocell(const char* path, QuadTree* tree)
+{
+	MappedFile file;
+	if (!mapFile(path, &file))
+	{
+		return false;
+	}
+	if (!isMacrocell(file.data, file.size))
+	{
+		printf("%s is not a macrocell file\n", path);
+		unmapFile(&file);
+		return false;
+	}
+
+	initQuadTree(tree);
+	// line numbers in the file to nodes in the tree, line 0 is the empty node
+	std::vector<u32> lines(1, QUAD_EMPTY);
+	std::vector<u32> levels(1, 0);
+	const char* end = (const char*)file.data + file.size;
+	const char* next = NULL;
+	bool ok = true;
+	u64 lineNumber = 1;
+
+	for (const char* line = (const char*)file.data; line != end && ok; line = next, lineNumber++)
+	{
+		const char* newline = (const char*)memchr(line, '\n', end - line);
+		next = newline ? newline + 1 : end;
+		if (lineNumber == 1 || *line == '#' || *line == '\n' || *line == '\r')
+		{
+			continue;
+		}
+
+		if (*line == '.' || *line == '*' || *line == '$')
+		{
+			u64 bits;
+			ok = parseLeaf(line, next, &bits);
+			lines.push_back(makeQuadLeaf(tree, bits));
+			levels.push_back(QUAD_LEAF_LEVEL);
+			continue;
+		}
+
+		const char* cursor = line;
+		u32 level;
+		u32 children[4];
+		ok = parseNumber(&cursor, next, &level) && level > QUAD_LEAF_LEVEL && level <= MAX_QUAD_LEVEL;
+		for (u32 i = 0; i < 4 && ok; i++)
+		{
+			ok = parseNumber(&cursor, next, &children[i]) && children[i] < lines.size() &&
+				 (children[i] == 0 || levels[children[i]] == level - 1);
+		}
+		if (!ok)
+		{
+			break;
+		}
+		lines.push_back(makeQuadNode(tree, level,
+									 lines[children[0]], lines[children[1]],
+									 lines[children[2]], lines[children[3]]));
+		levels.push_back(level);
+	}
+	unmapFile(&file);
+
+	if (!ok)
+	{
+		printf("%s has a bad node on line %llu\n", path, lineNumber - 1);
+		initQuadTree(tree);
+		return false;
+	}
+
+	// the last node is the root
+	tree->root = lines.back();
+	tree->level = levels.size() > 1 ? levels.back() : QUAD_LEAF_LEVEL;
+	return true;
+}
+
+static u32 writeNode(FILE* file, const QuadTree* tree, u32 index, std::vector<u32>* lines, u32* lineCount)
+{
+	if (index == QUAD_EMPTY || (*lines)[index])
+	{
+		return (*lines)[index];
+	}
+
+	const QuadNode& node = tree->nodes[index];
+	if (node.level == QUAD_LEAF_LEVEL)
+	{
+		// rows are cut after their last live cell and trailing empty rows dropped
+		char text[8 * 9 + 2];
+		u32 length = 0;
+		u32 lastRowEnd = 0;
+		for (u32 row = 0; row < 8; row++)
+		{
+			u32 bits = (u32)(node.bits >> (row * 8)) & 0xff;
+			for (u32 column = 0; bits >> column; column++)
+			{
+				text[length++] = bits & (1u << column) ? '*' : '.';
+			}
+			text[length++] = '$';
+			lastRowEnd = bits ? length : lastRowEnd;
+		}
+		text[lastRowEnd] = '\n';
+		fwrite(text, 1, lastRowEnd + 1, file);
+	}
+	else
+	{
+		u32 children[4];
+		for (u32 i = 0; i < 4; i++)
+		{
+			children[i] = writeNode(file, tree, node.children[i], lines, lineCount);
+		}
+		fprintf(file, "%u %u %u %u %u\n", node.level, children[0], children[1], children[2], children[3]);
+	}
+
+	(*lines)[index] = ++*lineCount;
+	return (*lines)[index];
+}
+
+bool saveMacrocell(const char* path, const QuadTree* tree)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "[M2] (lgc)\n");
+	std::vector<u32> lines(tree->nodes.size(), 0);
+	u32 lineCount = 0;
+	if (tree->root == QUAD_EMPTY)
+	{
+		// an empty universe still needs a root
+		fprintf(file, "$\n");
+	}
+	else
+	{
+		writeNode(file, tree, tree->root, &lines, &lineCount);
+	}
+
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		printf("failed to write %s\n", path);
+	}
+	return ok;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "common.h"
+
+struct QuadTree;
+
+// golly's [M2] macrocell format: one line per unique node, leaves as 8x8
+// rows of . and * ended by $, interior nodes as "level nw ne sw se" where the
+// children are earlier line numbers counting from 1 and 0 is empty.
+// loading and saving never expands the tree, both are linear in unique nodes.
+bool loadMacrocell(const char* path, QuadTree* tree);
+bool saveMacrocell(const char* path, const QuadTree* tree);
+
+bool isMacrocell(const u8* data, u64 size);
@@ -2,24 +2,207 @@
 #include <glfw/glfw3.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <assert.h>
 #include <vector>
-
-typedef unsigned int u32;
+#include "camera.h"
+#include "checkpoint.h"
+#include "common.h"
+#include "damage.h"
+#include "exporter.h"
+#include "glext.h"
+#include "gpulife.h"
+#include "headless.h"
+#include "life.h"
+#include "options.h"
+#include "palette.h"
+#include "patterns.h"
+#include "platform.h"
+#include "programs.h"
+#include "recording.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "tiled.h"
+#include "uploader.h"
 
 void glfwCallback(int error, const char* description)
 {
 	printf("Error: %s\n", description);
 }
 
+// what the window callbacks reach through the user pointer
+struct Viewer
+{
+	Simulation* simulation;
+	Camera camera;
+	bool dragging;
+	double dragX;
+	double dragY;
+	Palette palette;
+	bool heatmap;
+	// the window was uncovered, the canvas is copied to it again
+	bool exposed;
+};
+
+// fraction of the view an arrow key pans by
+static const double PAN_STEP = 0.125;
+
 static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
-	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+	if (action != GLFW_PRESS && action != GLFW_REPEAT)
+	{
+		return;
+	}
+
+	Viewer* viewer = (Viewer*)glfwGetWindowUserPointer(window);
+	Simulation* simulation = viewer->simulation;
+	Camera* camera = &viewer->camera;
+	u32 rate = simulation->rate;
+	switch (key)
+	{
+		case GLFW_KEY_ESCAPE:
+		{
+			glfwSetWindowShouldClose(window, GLFW_TRUE);
+		} return;
+		case GLFW_KEY_LEFT:
+		{
+			panCamera(camera, -(double)camera->viewWidth * PAN_STEP, 0.0);
+		} return;
+		case GLFW_KEY_RIGHT:
+		{
+			panCamera(camera, camera->viewWidth * PAN_STEP, 0.0);
+		} return;
+		case GLFW_KEY_DOWN:
+		{
+			panCamera(camera, 0.0, -(double)camera->viewHeight * PAN_STEP);
+		} return;
+		case GLFW_KEY_UP:
+		{
+			panCamera(camera, 0.0, camera->viewHeight * PAN_STEP);
+		} return;
+		case GLFW_KEY_PAGE_UP:
+		{
+			zoomCamera(camera, 0.5, camera->viewWidth * 0.5, camera->viewHeight * 0.5);
+		} return;
+		case GLFW_KEY_PAGE_DOWN:
+		{
+			zoomCamera(camera, 2.0, camera->viewWidth * 0.5, camera->viewHeight * 0.5);
+		} return;
+		case GLFW_KEY_HOME:
+		{
+			resetCamera(camera);
+		} return;
+		case GLFW_KEY_C:
+		{
+			// the loop uploads it before the next draw
+			viewer->palette = (Palette)((viewer->palette + 1) % NUM_PALETTES);
+			printf("%s palette\n", paletteName(viewer->palette));
+		} return;
+		case GLFW_KEY_H:
+		{
+			viewer->heatmap = !viewer->heatmap;
+		} return;
+		case GLFW_KEY_SPACE:
+		{
+			if (action == GLFW_PRESS)
+			{
+				// a settled board is let go rather than paused
+				bool paused = !simulation->paused && !simulation->settled;
+				simulation->paused = paused;
+				simulation->settled = false;
+				wakeSimulation(simulation);
+				printf("%s\n", paused ? "paused" : (simulation->finished ? "the replay has finished" : "running"));
+			}
+		} return;
+		case GLFW_KEY_EQUAL:
+		case GLFW_KEY_KP_ADD:
+		{
+			// doubling past the fastest rate goes unlimited
+			rate = rate == 0 || rate >= MAX_GENERATION_RATE ? 0 : rate * 2;
+		} break;
+		case GLFW_KEY_MINUS:
+		case GLFW_KEY_KP_SUBTRACT:
+		{
+			rate = rate == 0 ? MAX_GENERATION_RATE : (rate > 1 ? rate / 2 : 1);
+		} break;
+		case GLFW_KEY_0:
+		case GLFW_KEY_KP_0:
+		{
+			rate = 0;
+		} break;
+		case GLFW_KEY_BACKSPACE:
+		{
+			rate = DEFAULT_GENERATION_RATE;
+		} break;
+		default:
+		{
+		} return;
+	}
+
+	if (rate != simulation->rate)
+	{
+		simulation->rate = rate;
+		if (rate)
+		{
+			printf("%u generations/s\n", rate);
+		}
+		else
+		{
+			printf("unlimited generations/s\n");
+		}
+	}
+}
+
+static void scrollCallback(GLFWwindow* window, double offsetX, double offsetY)
+{
+	Viewer* viewer = (Viewer*)glfwGetWindowUserPointer(window);
+	double x = 0.0, y = 0.0;
+	glfwGetCursorPos(window, &x, &y);
+	// a notch of the wheel zooms in or out by half a power of two around the cursor
+	zoomCamera(&viewer->camera, pow(2.0, -offsetY * 0.5), x, viewer->camera.viewHeight - y);
+}
+
+static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
+{
+	Viewer* viewer = (Viewer*)glfwGetWindowUserPointer(window);
+	if (button == GLFW_MOUSE_BUTTON_LEFT)
+	{
+		viewer->dragging = action == GLFW_PRESS;
+		glfwGetCursorPos(window, &viewer->dragX, &viewer->dragY);
+	}
+}
+
+static void refreshCallback(GLFWwindow* window)
+{
+	Viewer* viewer = (Viewer*)glfwGetWindowUserPointer(window);
+	viewer->exposed = true;
+}
+
+static void cursorCallback(GLFWwindow* window, double x, double y)
+{
+	Viewer* viewer = (Viewer*)glfwGetWindowUserPointer(window);
+	if (viewer->dragging)
 	{
-		glfwSetWindowShouldClose(window, GLFW_TRUE);
+		// the board follows the cursor, cursor y runs down
+		panCamera(&viewer->camera, viewer->dragX - x, y - viewer->dragY);
+		viewer->dragX = x;
+		viewer->dragY = y;
 	}
 }
 
+// extracts a tiled board at the camera's zoom from the block below its corner
+static void requestTiledView(Simulation* simulation, const Camera* camera)
+{
+	u32 level = cameraLevel(camera);
+	u64 blockSize = 1ull << level;
+	double originX = 0.0, originY = 0.0;
+	cameraOrigin(camera, &originX, &originY);
+	u64 x = originX > 0.0 ? (u64)originX / blockSize * blockSize : 0;
+	u64 y = originY > 0.0 ? (u64)originY / blockSize * blockSize : 0;
+	setSimulationView(simulation, x, y, level);
+}
+
 void printError(u32 glError)
 {
 	switch (glError)
@@ -62,103 +245,243 @@ void printError(u32 glError)
 	}
 }
 
-bool checkShaderCompile(u32 shader)
-{
-	GLint isCompiled = 0;
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
-	if (isCompiled == GL_FALSE)
-	{
-		GLint maxLength = 0;
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+// set once errors come through oglDebugCallback
+static bool debugOutput = false;
 
-		// The maxLength includes the NULL character
-		std::vector<GLchar> errorLog(maxLength);
-		glGetShaderInfoLog(shader, maxLength, &maxLength, &errorLog[0]);
+#ifdef NDEBUG
+// release builds don't look for errors unless --gl-debug-sync asks for the callback
+#define GLE
+#else
+// drivers without KHR_debug are asked after every call instead
+#define GLE { if (!debugOutput) { u32 error = glGetError(); printError(error); assert(error == GL_NO_ERROR); } }
+#endif
+
+static const u32 NUM_NEIGHTBOURS = 9;
+static const u32 WIDTH = 480;
+static const u32 HEIGHT = 640;
+// longest an idle loop waits for events, everything that needs a draw sends one
+static const double IDLE_WAIT_SECONDS = 0.5;
 
-		printf(&errorLog[0]);
-		printf("\n");
+void APIENTRY oglDebugCallback(GLenum source,
+							   GLenum type,
+							   GLuint id,
+							   GLenum severity,
+							   GLsizei length,
+							   const GLchar* message,
+							   const void* userParam)
+{
+	printf("gl %s %u: %s\n", type == GL_DEBUG_TYPE_ERROR ? "error" : "message", id, message);
+	// with synchronous output the call that failed is still on the stack
+	assert(type != GL_DEBUG_TYPE_ERROR);
+}
 
-		// Exit with failure.
-		glDeleteShader(shader); // Don't leak the shader.
+// routes errors through the callback, false when the context can't
+static bool enableDebugOutput(bool synchronous)
+{
+	if (!glDebugMessageCallback || !glDebugMessageControl || (!hasGLVersion(4, 3) && !hasGLExtension("GL_KHR_debug")))
+	{
 		return false;
 	}
-
+	GLint flags = 0;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+	{
+		return false;
+	}
+	glEnable(GL_DEBUG_OUTPUT);
+	if (synchronous)
+	{
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	}
+	glDebugMessageCallback(oglDebugCallback, NULL);
+	// notifications are the driver describing buffer placement and the like
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
 	return true;
 }
 
-
-#define GLE {u32 error = glGetError(); printError(error); assert(error == GL_NO_ERROR); }
-
-static const u32 NUM_NEIGHTBOURS = 9;
-static const u32 WIDTH = 480;
-static const u32 HEIGHT = 640;
-
-void APIENTRY oglDebugCallback(GLenum source​,
-							   GLenum type​,
-							   GLuint id​,
-							   GLenum severity​,
-							   GLsizei length​,
-							   const GLchar* message​,
-							   const void* userParam​)
+static u64 timerValue()
 {
-	printf(message​);
+	return glfwGetTimerValue();
 }
 
-static char logBuffer[512] = {};
-
 int main(int argc, char** argv)
 {
+	Options options;
+	if (!parseOptions(argc, argv, &options))
+	{
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	// a video on stdout has to have it to itself from the first message on
+	if (options.exportPath && strcmp(options.exportPath, "-") == 0 && !takeStdout())
+	{
+		printf("failed to take stdout for the export\n");
+		return 1;
+	}
+
+	Life life;
+	u32 boardWidth = options.boardWidth ? options.boardWidth : WIDTH;
+	u32 boardHeight = options.boardHeight ? options.boardHeight : HEIGHT;
+	bool checkpointing = options.checkpointPath != NULL;
+	TiledLife tiled;
+	bool tiling = options.tiledPath != NULL;
+	if (tiling)
+	{
+		if (!openTiledLife(&tiled, options.tiledPath, boardWidth, boardHeight, options.tileCache ? options.tileCache : DEFAULT_TILE_CACHE))
+		{
+			return 1;
+		}
+		if (options.patternPath && !loadTiledPattern(&tiled, options.patternPath))
+		{
+			closeTiledLife(&tiled);
+			return 1;
+		}
+
+		// the in memory board only holds what's in view, extracted by the
+		// simulation at the camera's zoom. a view that isn't aligned to the
+		// extracted blocks can straddle one more of them.
+		initLife(&life, WIDTH + 1, HEIGHT + 1);
+		life.generation = tiledGeneration(&tiled);
+	}
+	else if (checkpointing && restoreCheckpoint(options.checkpointPath, &life))
+	{
+		printf("restored generation %llu from %s\n", life.generation, options.checkpointPath);
+	}
+	else if (options.patternPath)
+	{
+		if (!loadPattern(options.patternPath, &life, boardWidth, boardHeight, options.boardWidth == 0))
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		initLife(&life, boardWidth, boardHeight);
+	}
+
+	Replay replay;
+	bool replaying = options.replayPath != NULL;
+	if (replaying)
+	{
+		if (!openReplay(&replay, options.replayPath))
+		{
+			return 1;
+		}
+		u64 start = options.seekGeneration > replay.header.firstGeneration ? options.seekGeneration : replay.header.firstGeneration;
+		initLife(&life, replay.header.width, replay.header.height);
+		if (!seekReplay(&replay, start, currentAges(&life)))
+		{
+			printf("generation %llu is not in %s\n", start, options.replayPath);
+			return 1;
+		}
+		life.generation = replayGeneration(&replay);
+	}
+
+	// a headless --gpu run still needs a window for its context
+	if (options.headless && !options.gpu)
+	{
+		return runHeadless(&options, &life, tiling ? &tiled : NULL, NULL);
+	}
+
 	if (!glfwInit())
 	{
+		if (tiling)
+		{
+			closeTiledLife(&tiled);
+		}
 		return 1;
 	}
 	glfwSetErrorCallback(glfwCallback);
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, 1);
+	// compute shaders need 4.3
+	bool gpuStepping = options.gpu;
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, gpuStepping ? 3 : 0);
+#ifdef NDEBUG
+	bool debugContext = options.glDebugSync;
+#else
+	bool debugContext = true;
+#endif
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, debugContext);
+	if (options.offscreen || options.headless)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
 	GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "LGC", NULL, NULL);
 	if (!window)
 	{
+		if (tiling)
+		{
+			closeTiledLife(&tiled);
+		}
 		glfwTerminate();
 		return 1;
 	}
 	glfwMakeContextCurrent(window);
 	gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+	loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+	debugOutput = debugContext && enableDebugOutput(options.glDebugSync);
+	if (options.glDebugSync && !debugOutput)
+	{
+		printf("--gl-debug-sync needs KHR_debug, the driver doesn't have it\n");
+	}
+	if (gpuStepping && !gpuLifeSupported())
+	{
+		printf("--gpu needs opengl 4.3, the driver has %d.%d\n", GLVersion.major, GLVersion.minor);
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 1;
+	}
+	ProgramCache programCache;
+	initProgramCache(&programCache, options.shaderCachePath);
+	if (options.headless)
+	{
+		GpuLife gpu;
+		int result = 1;
+		if (initGpuLife(&gpu, &life, &programCache))
+		{
+			result = runHeadless(&options, &life, NULL, &gpu);
+			printf("gpu: %llu bytes uploaded, %llu bytes read back\n", gpu.uploadedBytes, gpu.readbackBytes);
+			destroyGpuLife(&gpu);
+		}
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return result;
+	}
 	glfwSetKeyCallback(window, keyCallback);
-	glfwSwapInterval(1);
+	glfwSetScrollCallback(window, scrollCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetCursorPosCallback(window, cursorCallback);
+	glfwSetWindowRefreshCallback(window, refreshCallback);
+	// nothing is shown offscreen, frames are drawn as fast as they're exported
+	glfwSwapInterval(options.offscreen ? 0 : 1);
 
-	const u32 NUM_CELL_BUFFERS = 2;
 	int width = 0, height = 0;
 	glfwGetFramebufferSize(window, &width, &height);
 	assert(width == WIDTH);
 	assert(height == HEIGHT);
 
-	u32 currentCellBuffer = 0;
-
-	typedef u32 Ages[WIDTH][HEIGHT];
-	static Ages cellAges[NUM_CELL_BUFFERS] = {};
-
-	u32 ageBuffers[NUM_CELL_BUFFERS];
-	glGenBuffers(NUM_CELL_BUFFERS, ageBuffers);
-	GLE;
-	for (u32 i = 0; i < NUM_CELL_BUFFERS; i++)
+	// a hidden window only for its context, which shares buffers and fences with the main one
+	GLFWwindow* uploadContext = NULL;
+	if (options.uploadThread)
 	{
-		Ages* currentCellAges = &cellAges[i];
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		uploadContext = glfwCreateWindow(1, 1, "LGC uploads", NULL, window);
+		if (!uploadContext)
+		{
+			printf("no shared context for --upload-thread, uploading between draws\n");
+		}
+	}
 
-		memset(currentCellAges, 0, sizeof(Ages));
-		glBindBuffer(GL_TEXTURE_BUFFER, ageBuffers[i]);
-		GLE;
-		glBufferData(GL_TEXTURE_BUFFER,
-					 sizeof(Ages),
-					 currentCellAges,
-					 GL_DYNAMIC_DRAW);
+	// the gpu path draws its own packed buffers, the uploader only takes frames from the host
+	Uploader uploader;
+	if (!gpuStepping)
+	{
+		initUploader(&uploader, life.width, life.height, options.uploadFormat, currentAges(&life), uploadContext != NULL);
 		GLE;
 	}
 
-	u32 ageTextures[NUM_CELL_BUFFERS];
-	glGenTextures(NUM_CELL_BUFFERS, ageTextures);
-
 	struct Vert
 	{
 		float pos[2];
@@ -205,6 +528,9 @@ int main(int argc, char** argv)
 	GLE;
 	glBindVertexArray(vao);
 	GLE;
+	// the element binding is vao state, it has to be bound after the vao
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	GLE;
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vert), (void*)offsetof(Vert, pos));
 	GLE;
 	glEnableVertexAttribArray(0);
@@ -217,9 +543,12 @@ int main(int argc, char** argv)
 	const char rawVertexCode[] = 
 	R"END(
 		#version 400
-		in vec2 vPos;
+		layout(location = 0) in vec2 vPos;
+		layout(location = 1) in vec2 vUv;
+		out vec2 uv;
 		void main()
 		{
+		    uv = vUv;
 		    gl_Position = vec4(vPos, 0.0, 1.0);
 		}
 	)END";
@@ -235,161 +564,630 @@ int main(int argc, char** argv)
 
 		const int width = %i;
 		const int height = %i;
-		uniform samplerBuffer cellAges;
+		uniform usamplerBuffer cellAges;
+		// max pooled bands in blocks of 2^densityLevel cells, see DensityPyramid
+		uniform usampler2D density;
+		uniform int densityLevel;
+		// the cell at the bottom left corner of the window
+		uniform vec2 viewOrigin;
+		uniform float cellsPerPixel;
+		// the lowest age of each colour band, see AGE_BAND_STARTS
+		const int bandStarts[5] = int[5](0, 1, 2, 11, 101);
+		// a colour for each age, see fillPalette
+		uniform sampler1D palette;
+		%s
+		%s
 
 		layout(location = 0) out vec4 color;
 
 		void main()
 		{
-		    int x = int(gl_FragCoord.x * width);
-		    int y = int(gl_FragCoord.y * height);
-			int cellAge = life.ages[x + y * width];
-			if(cellAge > 0)
+			vec2 cell = viewOrigin + gl_FragCoord.xy * cellsPerPixel;
+			if (cell.x < 0.0 || cell.y < 0.0 || cell.x >= float(width) || cell.y >= float(height))
 			{
-				if(cellAge > 100)
-				{
-					color = vec4(1.0, 1.0, 1.0, 1.0);
-				} else if(cellAge > 10)
-				{
-					color = vec4(0.75, 0.75, 0.75, 1.0);
-				} else if(cellAge > 1)
-				{
-					color = vec4(0.5, 0.5, 0.5, 1.0);
-				} else
-				{
-					color = vec4(0.25, 0.25, 0.25, 1.0);
-				}
+				discard;
+			}
+			int x = int(cell.x);
+			int y = int(cell.y);
+			int cellAge;
+			if (densityLevel > 0)
+			{
+				cellAge = bandStarts[texelFetch(density, ivec2(x >> densityLevel, y >> densityLevel), 0).r];
 			} else
 			{
-				color = vec4(0.0, 0.0, 0.0, 1.0);
+				cellAge = fetchAge(x, y);
+			}
+			color = texelFetch(palette, min(cellAge, textureSize(palette, 0) - 1), 0);
+			if (heatmap)
+			{
+				color.rgb = blendHeat(color.rgb, cell);
 			}
-			 
 		}
 	)END";
-	const u32 fragmentBufferSize = sizeof(rawFragmentCode) * 2;
+
+	// how a cell's age is fetched, one for each layout of the drawn buffer
+	const char ageFetchCode[] =
+	R"END(
+		int fetchAge(int x, int y)
+		{
+			return int(texelFetch(cellAges, x + y * width).r);
+		}
+	)END";
+	const char bandFetchCode[] =
+	R"END(
+		// a byte a cell holding its colour band
+		int fetchAge(int x, int y)
+		{
+			return bandStarts[texelFetch(cellAges, x + y * width).r];
+		}
+	)END";
+	const char packedFetchCode[] =
+	R"END(
+		// 32 cells a texel and every row starts on a new one, there are no ages
+		const int rowWords = (width + 31) / 32;
+		int fetchAge(int x, int y)
+		{
+			uint word = texelFetch(cellAges, (x >> 5) + y * rowWords).r;
+			return int((word >> uint(x & 31)) & 1u);
+		}
+	)END";
+
+	// shared by both programs, the tile a cell is in and how fast heat fades come from the uploader
+	const char rawHeatCode[] =
+	R"END(
+		// recent births and deaths around a cell, see Uploader::heat
+		uniform usampler2D heat;
+		uniform uint heatClock;
+		uniform bool heatmap;
+		vec3 blendHeat(vec3 color, vec2 cell)
+		{
+			ivec2 tile = min(ivec2(cell) / ivec2(%i, %i), textureSize(heat, 0) - 1);
+			uvec2 entry = texelFetch(heat, tile, 0).rg;
+			float value = uintBitsToFloat(entry.r) * exp2(-float(heatClock - entry.g) / %i.0);
+			// a tile that changes every frame is close to the full glow
+			float glow = 1.0 - exp2(-value * 0.25);
+			return mix(color, vec3(1.0, 0.35, 0.0), glow * 0.75);
+		}
+	)END";
+	const u32 heatBufferSize = sizeof(rawHeatCode) * 2;
+	char heatCode[heatBufferSize] = {};
+	u32 heatWritten = sprintf_s(heatCode, heatBufferSize, rawHeatCode, DIRTY_TILE_WIDTH, DIRTY_TILE_HEIGHT, HEAT_HALF_LIFE);
+	assert(heatWritten < heatBufferSize);
+
+	const u32 fragmentBufferSize = sizeof(rawFragmentCode) * 2 + heatBufferSize;
 	char fragmentCode[fragmentBufferSize] = {};
-	u32 fragmentWritten = sprintf_s(fragmentCode, fragmentBufferSize, rawFragmentCode, WIDTH, HEIGHT);
+	const char* fetchCode = ageFetchCode;
+	if (gpuStepping || options.uploadFormat == UPLOAD_BITS)
+	{
+		fetchCode = packedFetchCode;
+	}
+	else if (options.uploadFormat == UPLOAD_BANDS)
+	{
+		fetchCode = bandFetchCode;
+	}
+	u32 fragmentWritten = sprintf_s(fragmentCode, fragmentBufferSize, rawFragmentCode, life.width, life.height, fetchCode, heatCode);
 	assert(fragmentWritten < fragmentBufferSize);
 
-	u32 vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	const char* vertexCode2 = vertexCode;
-	glShaderSource(vertexShader, 1, &vertexCode2, NULL);
+	// programs are only started here and waited on once everything else is set up
+	PendingProgram pendingPipeline;
+	beginProgram(&programCache, &pendingPipeline, vertexCode, fragmentCode);
+
+	// nearly empty boards are drawn from a list of their live cells, a quad an
+	// instance over the same vao with the cell in attribute 2
+	const char rawSparseVertexCode[] =
+	R"END(
+		#version 400
+		layout(location = 0) in vec2 vPos;
+		layout(location = 1) in vec2 vUv;
+		// x and y, with the colour band in the top 3 bits of y, see UPLOAD_BAND_SHIFT
+		layout(location = 2) in uvec2 cell;
+		const vec2 boardSize = vec2(%i, %i);
+		const vec2 windowSize = vec2(%i, %i);
+		uniform vec2 viewOrigin;
+		uniform float cellsPerPixel;
+		// the lowest age of each colour band, see AGE_BAND_STARTS
+		const int bandStarts[5] = int[5](0, 1, 2, 11, 101);
+		flat out int age;
+		void main()
+		{
+			// the first instance is the board itself, the dead cells show it
+			vec2 corner = vec2(0.0);
+			vec2 size = boardSize / cellsPerPixel;
+			age = 0;
+			if (gl_InstanceID > 0)
+			{
+				corner = vec2(cell.x, cell.y & 0x1fffffffu);
+				age = bandStarts[cell.y >> 29u];
+				// a cell is kept at least a pixel wide or it could miss every pixel centre
+				size = vec2(max(1.0, 1.0 / cellsPerPixel));
+			}
+			vec2 pixel = (corner - viewOrigin) / cellsPerPixel + vUv * size;
+			gl_Position = vec4(pixel / windowSize * 2.0 - 1.0, 0.0, 1.0);
+		}
+	)END";
+	const char rawSparseFragmentCode[] =
+	R"END(
+		#version 400
+		flat in int age;
+		uniform vec2 viewOrigin;
+		uniform float cellsPerPixel;
+		uniform sampler1D palette;
+		%s
+		layout(location = 0) out vec4 color;
+		void main()
+		{
+			color = texelFetch(palette, min(age, textureSize(palette, 0) - 1), 0);
+			if (heatmap)
+			{
+				color.rgb = blendHeat(color.rgb, viewOrigin + gl_FragCoord.xy * cellsPerPixel);
+			}
+		}
+	)END";
+
+	const u32 sparseVertexBufferSize = sizeof(rawSparseVertexCode) * 2;
+	char sparseVertexCode[sparseVertexBufferSize] = {};
+	u32 sparseVertexWritten = sprintf_s(sparseVertexCode, sparseVertexBufferSize, rawSparseVertexCode, life.width, life.height, WIDTH, HEIGHT);
+	assert(sparseVertexWritten < sparseVertexBufferSize);
+	const u32 sparseFragmentBufferSize = sizeof(rawSparseFragmentCode) + heatBufferSize;
+	char sparseFragmentCode[sparseFragmentBufferSize] = {};
+	u32 sparseFragmentWritten = sprintf_s(sparseFragmentCode, sparseFragmentBufferSize, rawSparseFragmentCode, heatCode);
+	assert(sparseFragmentWritten < sparseFragmentBufferSize);
+	PendingProgram pendingSparsePipeline;
+	beginProgram(&programCache, &pendingSparsePipeline, sparseVertexCode, sparseFragmentCode);
+
+	GpuLife gpu;
+	if (gpuStepping && !initGpuLife(&gpu, &life, &programCache))
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 1;
+	}
+
+	u32 pipeline = finishProgram(&programCache, &pendingPipeline);
+	u32 sparsePipeline = finishProgram(&programCache, &pendingSparsePipeline);
+	if (!pipeline || !sparsePipeline)
+	{
+		if (gpuStepping)
+		{
+			destroyGpuLife(&gpu);
+		}
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 1;
+	}
+	glUseProgram(pipeline);
+	GLE;
+	glUniform1i(glGetUniformLocation(pipeline, "cellAges"), 0);
 	GLE;
-	glCompileShader(vertexShader);
-	assert(checkShaderCompile(vertexShader));
-	u32 fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	const char* fragmentCode2 = fragmentCode;
-	glShaderSource(fragmentShader, 1, &fragmentCode2, NULL);
+	glUniform1i(glGetUniformLocation(pipeline, "density"), 1);
 	GLE;
-	glCompileShader(fragmentShader);
-	assert(checkShaderCompile(fragmentShader));
+	GLint viewOriginLocation = glGetUniformLocation(pipeline, "viewOrigin");
+	GLint cellsPerPixelLocation = glGetUniformLocation(pipeline, "cellsPerPixel");
+	GLint densityLevelLocation = glGetUniformLocation(pipeline, "densityLevel");
+	glUniform1i(glGetUniformLocation(pipeline, "palette"), 2);
+	GLE;
+	glUniform1i(glGetUniformLocation(pipeline, "heat"), 3);
+	GLE;
+	GLint heatmapLocation = glGetUniformLocation(pipeline, "heatmap");
+	GLint heatClockLocation = glGetUniformLocation(pipeline, "heatClock");
+	GLint sparseHeatmapLocation = glGetUniformLocation(sparsePipeline, "heatmap");
+	GLint sparseHeatClockLocation = glGetUniformLocation(sparsePipeline, "heatClock");
+	GLint sparseOriginLocation = glGetUniformLocation(sparsePipeline, "viewOrigin");
+	GLint sparseCellsPerPixelLocation = glGetUniformLocation(sparsePipeline, "cellsPerPixel");
+	glUseProgram(sparsePipeline);
+	GLE;
+	glUniform1i(glGetUniformLocation(sparsePipeline, "palette"), 2);
+	GLE;
+	glUniform1i(glGetUniformLocation(sparsePipeline, "heat"), 3);
 	GLE;
 
-	u32 pipeline = glCreateProgram();
+	// colours are only data, switching palettes leaves the programs alone. the
+	// table stays bound to unit 2 for the whole run.
+	u8 paletteColors[PALETTE_SIZE * 4];
+	fillPalette(options.palette, paletteColors);
+	u32 paletteTexture;
+	glGenTextures(1, &paletteTexture);
+	GLE;
+	glActiveTexture(GL_TEXTURE2);
 	GLE;
-	glAttachShader(pipeline, vertexShader);
+	glBindTexture(GL_TEXTURE_1D, paletteTexture);
 	GLE;
-	glAttachShader(pipeline, fragmentShader);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA8, PALETTE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, paletteColors);
 	GLE;
-	glLinkProgram(pipeline);
+
+	// frames are drawn into a canvas that keeps them, so a frame only redraws
+	// what changed and the window gets a copy of the whole
+	u32 canvasColor;
+	glGenRenderbuffers(1, &canvasColor);
+	glBindRenderbuffer(GL_RENDERBUFFER, canvasColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+	GLE;
+	u32 canvas;
+	glGenFramebuffers(1, &canvas);
+	glBindFramebuffer(GL_FRAMEBUFFER, canvas);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, canvasColor);
 	GLE;
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	printf("programs: %llu from the cache, %llu compiled%s\n", programCache.hits, programCache.compiles,
+		   programCache.parallel ? " in parallel" : "");
+
+	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	u32 refreshRate = mode && mode->refreshRate > 0 ? mode->refreshRate : 60;
 
-	int success = false;
-	glGetProgramiv(pipeline, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(pipeline, sizeof(logBuffer), NULL, logBuffer);
-		printf("SHADER LINK FAILED\n%s\n", logBuffer);
-		assert(false);
+	// exported videos play back at the refresh rate the frames were paced for
+	Exporter exporter;
+	bool exporting = options.exportPath != NULL;
+	if (exporting && !openExporter(&exporter, options.exportPath, WIDTH, HEIGHT, refreshRate))
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 1;
 	}
 
-	while (!glfwWindowShouldClose(window))
+	Recorder recorder;
+	bool recording = options.recordPath != NULL;
+	if (recording)
+	{
+		if (!openRecorder(&recorder, options.recordPath, &life, options.keyframeInterval))
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return 1;
+		}
+		recordGeneration(&recorder, &life);
+	}
+
+	Checkpointer checkpointer;
+	if (checkpointing)
 	{
-		u32 nextCellBufferIndex = (currentCellBuffer + 1) % NUM_CELL_BUFFERS;
-		// input
-		glfwPollEvents();
+		startCheckpointer(&checkpointer, options.checkpointPath);
+	}
 
-		glBindBuffer(GL_TEXTURE_BUFFER, ageBuffers[currentCellBuffer]);
-		GLE;
-		// update the host buffer
-		for (u32 i = 1; i < WIDTH - 1; i++)
+	// the board belongs to the simulation thread until it is stopped
+	Simulation simulation;
+	initSimulation(&simulation, &life);
+	simulation.replay = replaying ? &replay : NULL;
+	simulation.tiled = tiling ? &tiled : NULL;
+	simulation.recorder = recording ? &recorder : NULL;
+	simulation.checkpointer = checkpointing ? &checkpointer : NULL;
+	simulation.checkpointInterval = options.checkpointInterval ? options.checkpointInterval : DEFAULT_CHECKPOINT_INTERVAL;
+	// by then every live cell is past the palette's last colour, holding the
+	// board doesn't change what's on screen
+	simulation.settleAfter = options.settle ? PALETTE_SIZE : 0;
+	u32 generationRate = options.unlimitedRate ? 0 : (options.generationRate ? options.generationRate : DEFAULT_GENERATION_RATE);
+	// a frame of generations should be ready every refresh
+	u64 timerFrequency = glfwGetTimerFrequency();
+	u64 frameBudget = options.frameBudget ? timerFrequency * options.frameBudget / 1000000 : timerFrequency / refreshRate;
+	Viewer viewer = {};
+	viewer.simulation = &simulation;
+	viewer.palette = options.palette;
+	viewer.heatmap = options.heatmap;
+	Palette drawnPalette = options.palette;
+	initCamera(&viewer.camera, tiling ? tiled.width : life.width, tiling ? tiled.height : life.height, WIDTH, HEIGHT);
+	if (tiling)
+	{
+		requestTiledView(&simulation, &viewer.camera);
+	}
+	if (gpuStepping)
+	{
+		// the device steps on this thread between draws
+		simulation.gpu = &gpu;
+		setSimulationClock(&simulation, generationRate, timerValue, timerFrequency);
+	}
+	else
+	{
+		// the upload thread wakes the renderer itself once a frame is uploaded
+		simulation.wakeRenderer = uploadContext ? NULL : glfwPostEmptyEvent;
+		startSimulation(&simulation, generationRate, timerValue, timerFrequency, frameBudget);
+		if (uploadContext)
+		{
+			startUploadThread(&uploader, &simulation, uploadContext);
+		}
+	}
+	glfwSetWindowUserPointer(window, &viewer);
+
+	// what the canvas holds, see Damage
+	Damage damage;
+	std::vector<u8> damagedTiles;
+	bool redrawAll = true;
+	double drawnOriginX = 0.0, drawnOriginY = 0.0, drawnCellsPerPixel = 0.0;
+	FrameView drawnView = {0, 0, 0};
+	u32 drawnLevel = 0;
+	bool drawnHeatmap = false;
+	bool idle = false;
+	u64 fullRedraws = 0, partialRedraws = 0, skippedRedraws = 0;
+
+	while (!glfwWindowShouldClose(window))
+	{
+		// without a swap to pace the loop it waits for input or the next frame,
+		// which the simulation's threads post an event for. stepping here, the
+		// next generation is due in ticks.
+		if (idle)
 		{
-			for (u32 j = 1; j < HEIGHT - 1; j++)
+			double wait = IDLE_WAIT_SECONDS;
+			if (gpuStepping && !simulationHeld(&simulation))
 			{
-				Ages* cellBuffer = &cellAges[currentCellBuffer];
-				Ages* nextCellBuffer = &cellAges[nextCellBufferIndex];
+				Scheduler* scheduler = &simulation.scheduler;
+				double due = (double)ticksUntilDue(scheduler) / scheduler->frequency;
+				wait = due < wait ? due : wait;
+			}
+			glfwWaitEventsTimeout(wait);
+		}
+		else
+		{
+			glfwPollEvents();
+		}
+		if (tiling)
+		{
+			requestTiledView(&simulation, &viewer.camera);
+		}
+
+		// update the device buffer, only when the simulation has moved on
+		const SimulationFrame* frame = NULL;
+		bool fresh = false;
+		if (gpuStepping)
+		{
+			// the dispatches are only queued here, timing them says nothing
+			fresh = advanceSimulation(&simulation, MAX_GPU_GENERATIONS_PER_FRAME, 0) > 0;
+		}
+		else if (uploader.threaded)
+		{
+			fresh = takeUpload(&uploader);
+			GLE;
+		}
+		else if (acquireFrame(&simulation, &frame))
+		{
+			uploadFrame(&uploader, frame);
+			fresh = true;
+			GLE;
+		}
+
+		if (viewer.palette != drawnPalette)
+		{
+			drawnPalette = viewer.palette;
+			fillPalette(drawnPalette, paletteColors);
+			glActiveTexture(GL_TEXTURE2);
+			GLE;
+			glTexSubImage1D(GL_TEXTURE_1D, 0, 0, PALETTE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, paletteColors);
+			GLE;
+			redrawAll = true;
+		}
+
+		// the camera in the drawn frame's texels, which are blocks of cells for tiled boards
+		FrameView view = {0, 0, 0};
+		if (!gpuStepping)
+		{
+			view = uploadView(&uploader);
+		}
+		double blockSize = (double)(1ull << view.level);
+		double originX = 0.0, originY = 0.0;
+		cameraOrigin(&viewer.camera, &originX, &originY);
+		originX = (originX - view.x) / blockSize;
+		originY = (originY - view.y) / blockSize;
+		double cellsPerPixel = viewer.camera.cellsPerPixel / blockSize;
 
-				u32 numAliveNeighbours = 0;
+		// zoomed out past a pixel a cell the pyramid is drawn instead, levels
+		// too big for a texture fall back to a coarser one or the cells
+		bool sparse = !gpuStepping && uploadSparse(&uploader);
+		u32 level = gpuStepping || sparse ? 0 : scaleLevel(cellsPerPixel);
+		while (level && level <= uploader.pyramid.levelCount && !pyramidTexture(&uploader, level - 1))
+		{
+			level++;
+		}
+		level = gpuStepping || level > uploader.pyramid.levelCount ? 0 : level;
+		bool heatmap = viewer.heatmap && !gpuStepping && uploadHeatTexture(&uploader);
+
+		// only the tiles that changed are drawn again, unless anything else
+		// did. the heat fades everywhere at once, so it redraws everything.
+		clearDamage(&damage, WIDTH, HEIGHT);
+		bool allTiles = gpuStepping ? fresh : takeDamage(&uploader, &damagedTiles);
+		bool moved = originX != drawnOriginX || originY != drawnOriginY || cellsPerPixel != drawnCellsPerPixel ||
+			view.x != drawnView.x || view.y != drawnView.y || view.level != drawnView.level || level != drawnLevel;
+		if (redrawAll || allTiles || moved || heatmap != drawnHeatmap || (heatmap && fresh))
+		{
+			damageWindow(&damage);
+		}
+		else if (!gpuStepping)
+		{
+			damageTiles(&damage, damagedTiles.data(), uploader.tileColumns, uploader.tileRows, originX, originY, cellsPerPixel, level);
+		}
+		DamageBox boxes[DAMAGE_BANDS];
+		u32 boxCount = damageBoxes(&damage, boxes);
+		redrawAll = false;
+		drawnOriginX = originX;
+		drawnOriginY = originY;
+		drawnCellsPerPixel = cellsPerPixel;
+		drawnView = view;
+		drawnLevel = level;
+		drawnHeatmap = heatmap;
 
-				// top row
-				numAliveNeighbours += (*cellBuffer)[i - 1][j + 1] ? 1 : 0;
-				numAliveNeighbours += (*cellBuffer)[i][j + 1] ? 1 : 0;
-				numAliveNeighbours += (*cellBuffer)[i + 1][j + 1] ? 1 : 0;
+		if (boxCount)
+		{
+			bool whole = boxCount == 1 && boxes[0].x1 - boxes[0].x0 == WIDTH && boxes[0].y1 - boxes[0].y0 == HEIGHT;
+			if (whole)
+			{
+				fullRedraws++;
+			}
+			else
+			{
+				partialRedraws++;
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, canvas);
+			GLE;
+			glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+			GLE;
+			glBindVertexArray(vao);
+			GLE;
 
-				// middle row
-				numAliveNeighbours += (*cellBuffer)[i - 1][j] ? 1 : 0;
-				//numAliveNeighbours += (*cellBuffer)[i][j].alive? 1 : 0;
-				numAliveNeighbours += (*cellBuffer)[i + 1][j] ? 1 : 0;
+			// the heat of the drawn region, sits on unit 3 for either program
+			u32 heatClock = 0;
+			if (heatmap)
+			{
+				heatClock = uploadHeatClock(&uploader);
+				glActiveTexture(GL_TEXTURE3);
+				GLE;
+				glBindTexture(GL_TEXTURE_2D, uploadHeatTexture(&uploader));
+				GLE;
+			}
 
-				// bottom row
-				numAliveNeighbours += (*cellBuffer)[i - 1][j - 1] ? 1 : 0;
-				numAliveNeighbours += (*cellBuffer)[i][j - 1] ? 1 : 0;
-				numAliveNeighbours += (*cellBuffer)[i + 1][j - 1] ? 1 : 0;
+			if (sparse)
+			{
+				glUseProgram(sparsePipeline);
+				GLE;
+				glUniform2f(sparseOriginLocation, (float)originX, (float)originY);
+				glUniform1f(sparseCellsPerPixelLocation, (float)cellsPerPixel);
+				glUniform1i(sparseHeatmapLocation, heatmap);
+				glUniform1ui(sparseHeatClockLocation, heatClock);
+				glBindBuffer(GL_ARRAY_BUFFER, uploadInstances(&uploader));
+				glVertexAttribIPointer(2, 2, GL_UNSIGNED_INT, 0, (void*)0);
+				glVertexAttribDivisor(2, 1);
+				glEnableVertexAttribArray(2);
+				GLE;
+			}
+			else
+			{
+				glUseProgram(pipeline);
+				GLE;
+				glActiveTexture(GL_TEXTURE0);
+				GLE;
+				glBindTexture(GL_TEXTURE_BUFFER, gpuStepping ? gpuTexture(&gpu) : uploadTexture(&uploader));
+				GLE;
+				glActiveTexture(GL_TEXTURE1);
+				GLE;
+				glBindTexture(GL_TEXTURE_2D, level ? pyramidTexture(&uploader, level - 1) : 0);
+				GLE;
+				glUniform2f(viewOriginLocation, (float)originX, (float)originY);
+				glUniform1f(cellsPerPixelLocation, (float)cellsPerPixel);
+				glUniform1i(densityLevelLocation, level);
+				glUniform1i(heatmapLocation, heatmap);
+				glUniform1ui(heatClockLocation, heatClock);
+				GLE;
+			}
 
-				switch (numAliveNeighbours)
+			// a box at a time, the board behind the cells is cleared with them
+			glEnable(GL_SCISSOR_TEST);
+			for (u32 i = 0; i < boxCount; i++)
+			{
+				glScissor(boxes[i].x0, boxes[i].y0, boxes[i].x1 - boxes[i].x0, boxes[i].y1 - boxes[i].y0);
+				glClear(GL_COLOR_BUFFER_BIT);
+				GLE;
+				if (sparse)
+				{
+					glDrawElementsInstanced(GL_TRIANGLES, sizeof(indices)/sizeof(indices[0]), GL_UNSIGNED_INT, 0, uploadInstanceCount(&uploader));
+				}
+				else
 				{
-					case 0:
-					case 1:
-					{
-						(*nextCellBuffer)[i][j] = 0;
-					} break;
-					case 2:
-					case 3:
-					{
-						if ((*cellBuffer)[i][j])
-						{
-							(*nextCellBuffer)[i][j] = (*cellBuffer)[i][j] + 1;
-						}
-						else
-						{
-							(*nextCellBuffer)[i][j] = 1;
-						}
-					} break;
-					default:
-					{
-						(*nextCellBuffer)[i][j] = 0;
-					}
+					glDrawElements(GL_TRIANGLES, sizeof(indices)/sizeof(indices[0]), GL_UNSIGNED_INT, 0);
 				}
+				GLE;
+			}
+			glDisable(GL_SCISSOR_TEST);
+			if (sparse)
+			{
+				// the dense draw has no instances to read it from
+				glDisableVertexAttribArray(2);
+				GLE;
+			}
+			if (!gpuStepping)
+			{
+				fenceUpload(&uploader);
 			}
 		}
+		else
+		{
+			skippedRedraws++;
+		}
 
-		// update the device buffer
-		glBufferSubData(GL_TEXTURE_BUFFER, 
-						0, 
-						sizeof(Ages),
-						&cellAges[nextCellBufferIndex]);
-		GLE;
+		// only frames the simulation moved on are exported, and the first
+		if (exporting)
+		{
+			finishExportFrame(&exporter, canvas, fresh || exporter.nextIndex == 0);
+			GLE;
+			if (options.exportFrames && exporter.nextIndex >= options.exportFrames)
+			{
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			}
+		}
 
-		// clear and start drawing
-		glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
-		GLE;
-		glClear(GL_COLOR_BUFFER_BIT);
-		GLE;
-		glUseProgram(pipeline);
-		GLE;
-		//glBindVertexArray(vao);
-		GLE;
-		/*glBindBufferBase(GL_UNIFORM_BUFFER, 
-						 0, 
-						 cellUniforms[currentCellBuffer]);*/
-		GLE;
-		// glUniformBlockBinding(pipeline, cellsLocation, 0);
-		// GLE;
-		//glDrawElements(GL_TRIANGLES, sizeof(indices)/sizeof(indices[0]), GL_UNSIGNED_INT, 0);
-		GLE;
-		currentCellBuffer = nextCellBufferIndex;
+		// the canvas is copied to the window whole, a frame that drew nothing
+		// isn't swapped and the loop waits for input or the next frame instead
+		idle = !boxCount && !viewer.exposed;
+		if (!options.offscreen && !idle)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, canvas);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(0, 0, WIDTH, HEIGHT, 0, 0, WIDTH, HEIGHT, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			GLE;
+			glfwSwapBuffers(window);
+		}
+		viewer.exposed = false;
+	}
 
-		// swap
-		glfwSwapBuffers(window);
+	printf("redraws: %llu full, %llu partial, %llu skipped\n", fullRedraws, partialRedraws, skippedRedraws);
+	if (exporting)
+	{
+		closeExporter(&exporter);
+		printf("export: %llu frames, %llu bytes, %llu readbacks stalled, %llu frames waited on the encoders\n",
+			   exporter.frames, exporter.bytes, exporter.readbackStalls, exporter.encodeStalls);
+	}
+
+	if (gpuStepping)
+	{
+		// only read the board back if something is going to be written from it
+		if (options.savePath || checkpointing)
+		{
+			if (checkpointing)
+			{
+				waitForCheckpoint(&checkpointer);
+			}
+			readGpuLife(&gpu, &life);
+		}
+		printf("gpu: %llu bytes uploaded, %llu bytes read back\n", gpu.uploadedBytes, gpu.readbackBytes);
+		destroyGpuLife(&gpu);
+	}
+	else
+	{
+		// the upload thread reads the simulation's frames
+		stopUploadThread(&uploader);
+		stopSimulation(&simulation);
+		printf("frames: %llu published, %llu dropped, %llu drawn again, %llu uploads stalled%s\n",
+			   simulation.frames.published.load(), simulation.frames.dropped.load(), simulation.frames.duplicated.load(),
+			   uploader.stalls, uploader.persistent ? "" : " (buffer sub data)");
+		printf("uploads: %llu full, %llu partial, %llu sparse, %llu bytes, %llu never drawn\n",
+			   uploader.fullUploads, uploader.partialUploads, uploader.sparseUploads, uploader.uploadedBytes, uploader.skipped);
+		destroyUploader(&uploader);
+		if (uploadContext)
+		{
+			glfwDestroyWindow(uploadContext);
+		}
+	}
+
+	if (recording)
+	{
+		closeRecorder(&recorder);
+		printf("recording: %llu generations waited on the writer\n", recorder.stalls);
+	}
+	if (replaying)
+	{
+		closeReplay(&replay);
+	}
+	if (tiling)
+	{
+		closeTiledLife(&tiled);
+	}
+	if (options.savePath)
+	{
+		savePattern(options.savePath, &life);
+	}
+	if (checkpointing)
+	{
+		// save where we stopped, the buffers stay untouched until the writer is done
+		waitForCheckpoint(&checkpointer);
+		beginCheckpoint(&checkpointer, &life);
+		stopCheckpointer(&checkpointer);
 	}
 
 	glfwDestroyWindow(window);
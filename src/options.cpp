@@ -0,0 +1,328 @@
+#include "options.h"
+#include "headless.h"
+#include "patterns.h"
+#include "programs.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool parseNumber(const char* text, u64* value)
+{
+	char* end = NULL;
+	*value = strtoull(text, &end, 10);
+	return end != text && *end == '\0';
+}
+
+static bool parseSize(const char* text, u32* width, u32* height)
+{
+	char* end = NULL;
+	unsigned long long w = strtoull(text, &end, 10);
+	if (end == text || (*end != 'x' && *end != 'X'))
+	{
+		return false;
+	}
+	const char* rest = end + 1;
+	unsigned long long h = strtoull(rest, &end, 10);
+	if (end == rest || *end != '\0' || w < 3 || h < 3 || w > 0xffffffff || h > 0xffffffff)
+	{
+		return false;
+	}
+	*width = (u32)w;
+	*height = (u32)h;
+	return true;
+}
+
+bool parseOptions(int argc, char** argv, Options* options)
+{
+	*options = {};
+	options->shaderCachePath = DEFAULT_SHADER_CACHE;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+		u64 number = 0;
+
+		// flags without a value
+		if (strcmp(arg, "--headless") == 0)
+		{
+			options->headless = true;
+			continue;
+		}
+		if (strcmp(arg, "--gpu") == 0)
+		{
+			options->gpu = true;
+			continue;
+		}
+		if (strcmp(arg, "--upload-thread") == 0)
+		{
+			options->uploadThread = true;
+			continue;
+		}
+		if (strcmp(arg, "--no-shader-cache") == 0)
+		{
+			options->shaderCachePath = NULL;
+			continue;
+		}
+		if (strcmp(arg, "--heatmap") == 0)
+		{
+			options->heatmap = true;
+			continue;
+		}
+		if (strcmp(arg, "--gl-debug-sync") == 0)
+		{
+			options->glDebugSync = true;
+			continue;
+		}
+		if (strcmp(arg, "--offscreen") == 0)
+		{
+			options->offscreen = true;
+			continue;
+		}
+		if (strcmp(arg, "--check-gpu") == 0)
+		{
+			options->checkGpu = true;
+			continue;
+		}
+		if (strcmp(arg, "--settle") == 0)
+		{
+			options->settle = true;
+			continue;
+		}
+
+		if (!value)
+		{
+			printf("missing value for %s\n", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--record") == 0)
+		{
+			options->recordPath = value;
+		}
+		else if (strcmp(arg, "--replay") == 0)
+		{
+			options->replayPath = value;
+		}
+		else if (strcmp(arg, "--seek") == 0 && parseNumber(value, &number))
+		{
+			options->seekGeneration = number;
+		}
+		else if (strcmp(arg, "--keyframe-interval") == 0 && parseNumber(value, &number) && number > 0 && number <= 0xffffffff)
+		{
+			options->keyframeInterval = (u32)number;
+		}
+		else if (strcmp(arg, "--checkpoint") == 0)
+		{
+			options->checkpointPath = value;
+		}
+		else if (strcmp(arg, "--checkpoint-interval") == 0 && parseNumber(value, &number) && number > 0 && number <= 0xffffffff)
+		{
+			options->checkpointInterval = (u32)number;
+		}
+		else if (strcmp(arg, "--pattern") == 0)
+		{
+			options->patternPath = value;
+		}
+		else if (strcmp(arg, "--size") == 0 && parseSize(value, &options->boardWidth, &options->boardHeight))
+		{
+		}
+		else if (strcmp(arg, "--save") == 0 && canSavePattern(value))
+		{
+			options->savePath = value;
+		}
+		else if (strcmp(arg, "--tiled") == 0)
+		{
+			options->tiledPath = value;
+		}
+		else if (strcmp(arg, "--tile-cache") == 0 && parseNumber(value, &number) && number > 0 && number <= 0xffffffff)
+		{
+			options->tileCache = (u32)number;
+		}
+		else if (strcmp(arg, "--rate") == 0 && parseNumber(value, &number) && number <= MAX_GENERATION_RATE)
+		{
+			options->generationRate = (u32)number;
+			options->unlimitedRate = number == 0;
+		}
+		else if (strcmp(arg, "--frame-budget") == 0 && parseNumber(value, &number) && number > 0 && number <= 1000000)
+		{
+			options->frameBudget = (u32)number;
+		}
+		else if (strcmp(arg, "--generations") == 0 && parseNumber(value, &number))
+		{
+			options->generations = number;
+		}
+		else if (strcmp(arg, "--until") == 0 && strcmp(value, "extinct") == 0)
+		{
+			options->stopCondition = STOP_EXTINCT;
+		}
+		else if (strcmp(arg, "--until") == 0 && strcmp(value, "still") == 0)
+		{
+			options->stopCondition = STOP_STILL;
+		}
+		else if (strcmp(arg, "--stats") == 0)
+		{
+			options->statsPath = value;
+		}
+		else if (strcmp(arg, "--upload") == 0 && strcmp(value, "bands") == 0)
+		{
+			options->uploadFormat = UPLOAD_BANDS;
+		}
+		else if (strcmp(arg, "--upload") == 0 && strcmp(value, "ages") == 0)
+		{
+			options->uploadFormat = UPLOAD_AGES;
+		}
+		else if (strcmp(arg, "--upload") == 0 && strcmp(value, "bits") == 0)
+		{
+			options->uploadFormat = UPLOAD_BITS;
+		}
+		else if (strcmp(arg, "--palette") == 0 && strcmp(value, "gray") == 0)
+		{
+			options->palette = PALETTE_GRAY;
+		}
+		else if (strcmp(arg, "--palette") == 0 && strcmp(value, "heat") == 0)
+		{
+			options->palette = PALETTE_HEAT;
+		}
+		else if (strcmp(arg, "--palette") == 0 && strcmp(value, "mono") == 0)
+		{
+			options->palette = PALETTE_MONO;
+		}
+		else if (strcmp(arg, "--shader-cache") == 0)
+		{
+			options->shaderCachePath = value;
+		}
+		else if (strcmp(arg, "--export") == 0)
+		{
+			options->exportPath = value;
+		}
+		else if (strcmp(arg, "--export-frames") == 0 && parseNumber(value, &number) && number > 0)
+		{
+			options->exportFrames = number;
+		}
+		else if (strcmp(arg, "--stats-interval") == 0 && parseNumber(value, &number) && number > 0 && number <= 0xffffffff)
+		{
+			options->statsInterval = (u32)number;
+		}
+		else
+		{
+			printf("bad argument %s %s\n", arg, value);
+			return false;
+		}
+		i++;
+	}
+
+	if (options->recordPath && options->replayPath)
+	{
+		printf("--record and --replay can't be used together\n");
+		return false;
+	}
+	if (options->patternPath && options->replayPath)
+	{
+		printf("--pattern and --replay can't be used together\n");
+		return false;
+	}
+	if (!options->tiledPath && (u64)options->boardWidth * options->boardHeight > 0xffffffffull / sizeof(u32))
+	{
+		printf("a %u x %u board needs --tiled\n", options->boardWidth, options->boardHeight);
+		return false;
+	}
+	if (options->tiledPath && (options->recordPath || options->replayPath || options->checkpointPath || options->savePath))
+	{
+		printf("--tiled boards live in their file, they can't be recorded, replayed, checkpointed or saved\n");
+		return false;
+	}
+	if (options->checkpointPath && options->replayPath)
+	{
+		printf("--checkpoint and --replay can't be used together\n");
+		return false;
+	}
+	if (!options->headless && (options->generations || options->stopCondition != STOP_NEVER || options->statsPath))
+	{
+		printf("--generations, --until and --stats need --headless\n");
+		return false;
+	}
+	if (options->headless && options->replayPath)
+	{
+		printf("--headless and --replay can't be used together\n");
+		return false;
+	}
+	if (options->gpu && (options->recordPath || options->replayPath || options->tiledPath))
+	{
+		printf("--gpu can't be used with --record, --replay or --tiled\n");
+		return false;
+	}
+	if (options->gpu && options->stopCondition != STOP_NEVER)
+	{
+		printf("--until isn't supported with --gpu\n");
+		return false;
+	}
+	if (options->checkGpu && !(options->gpu && options->headless))
+	{
+		printf("--check-gpu needs --gpu and --headless\n");
+		return false;
+	}
+	if (options->uploadThread && (options->gpu || options->headless))
+	{
+		printf("--upload-thread can't be used with --gpu or --headless\n");
+		return false;
+	}
+	if ((options->offscreen || options->exportFrames) && !options->exportPath)
+	{
+		printf("--offscreen and --export-frames need --export\n");
+		return false;
+	}
+	if (options->exportPath && options->headless)
+	{
+		printf("--export draws the frames, it can't be used with --headless\n");
+		return false;
+	}
+	if (options->settle && (options->gpu || options->headless || options->replayPath || options->tiledPath || options->exportPath))
+	{
+		printf("--settle can't be used with --gpu, --headless, --replay, --tiled or --export\n");
+		return false;
+	}
+	if (options->tiledPath && options->stopCondition == STOP_STILL)
+	{
+		printf("--until still isn't supported on --tiled boards\n");
+		return false;
+	}
+	return true;
+}
+
+void printUsage(const char* program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("  --record <file>             stream every generation to a recording\n");
+	printf("  --keyframe-interval <n>     generations between recording keyframes\n");
+	printf("  --replay <file>             play back a recording instead of simulating\n");
+	printf("  --seek <generation>         generation to start the replay from\n");
+	printf("  --pattern <file>            start from an rle, life 1.06, plaintext or macrocell pattern\n");
+	printf("  --size <width>x<height>     board size, patterns grow the board when not given\n");
+	printf("  --save <file>               save the board on exit, .rle or .mc\n");
+	printf("  --tiled <file>              keep the board in a tiled file instead of memory\n");
+	printf("  --tile-cache <tiles>        tiles of a --tiled board kept mapped\n");
+	printf("  --rate <generations/s>      simulation speed, 0 runs as fast as possible\n");
+	printf("  --settle                    hold the board once it stops changing, space lets it go\n");
+	printf("  --frame-budget <us>         time to step between frames, a display refresh by default\n");
+	printf("  --upload <bands|ages|bits>  cell format sent to the gpu, bits drops the ages\n");
+	printf("  --palette <gray|heat|mono>  how cells are coloured by age, c cycles through them\n");
+	printf("  --heatmap                   start with recent activity glowing over the board, h toggles it\n");
+	printf("  --upload-thread             upload frames from a thread with its own gl context\n");
+	printf("  --shader-cache <dir>        where compiled shaders are kept, %s by default\n", DEFAULT_SHADER_CACHE);
+	printf("  --no-shader-cache           compile the shaders every run\n");
+	printf("  --gl-debug-sync             report gl errors from inside the failing call, slow\n");
+	printf("  --export <dir|file.y4m|->   write the drawn frames as pngs, a y4m video or y4m on stdout\n");
+	printf("  --export-frames <n>         quit after exporting n frames\n");
+	printf("  --offscreen                 export without showing the window\n");
+	printf("  --gpu                       step the board with a compute shader, needs opengl 4.3\n");
+	printf("  --check-gpu                 compare a headless --gpu run with the host stepping the same board\n");
+	printf("  --headless                  run without a window as fast as possible\n");
+	printf("  --generations <n>           stop a headless run after n generations\n");
+	printf("  --until <extinct|still>     stop a headless run once the board dies or stops changing\n");
+	printf("  --stats <file>              write headless population stats as csv\n");
+	printf("  --stats-interval <n>        generations between stats lines, %u by default\n", DEFAULT_STATS_INTERVAL);
+	printf("  --checkpoint <file>         restore from and periodically save to a checkpoint\n");
+	printf("  --checkpoint-interval <n>   generations between checkpoints\n");
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "common.h"
+
+enum StopCondition
+{
+	STOP_NEVER,
+	STOP_EXTINCT,
+	STOP_STILL,
+};
+
+// how the host's frames are laid out for the renderer
+enum UploadFormat
+{
+	UPLOAD_BANDS,
+	UPLOAD_AGES,
+	UPLOAD_BITS,
+};
+
+// how cell ages are coloured, see fillPalette
+enum Palette
+{
+	PALETTE_GRAY,
+	PALETTE_HEAT,
+	PALETTE_MONO,
+	NUM_PALETTES,
+};
+
+struct Options
+{
+	const char* recordPath;
+	const char* replayPath;
+	u64 seekGeneration;
+	u32 keyframeInterval;
+	const char* checkpointPath;
+	u32 checkpointInterval;
+	const char* patternPath;
+	u32 boardWidth;
+	u32 boardHeight;
+	const char* savePath;
+	const char* tiledPath;
+	u32 tileCache;
+	u32 generationRate;
+	bool unlimitedRate;
+	u32 frameBudget;
+	bool headless;
+	bool gpu;
+	u64 generations;
+	StopCondition stopCondition;
+	const char* statsPath;
+	u32 statsInterval;
+	UploadFormat uploadFormat;
+	bool uploadThread;
+	// NULL with --no-shader-cache
+	const char* shaderCachePath;
+	bool glDebugSync;
+	Palette palette;
+	bool heatmap;
+	const char* exportPath;
+	u64 exportFrames;
+	bool offscreen;
+	bool settle;
+	bool checkGpu;
+};
+
+bool parseOptions(int argc, char** argv, Options* options);
+void printUsage(const char* program);
@@ -0,0 +1,67 @@
+#include "palette.h"
+#include "pyramid.h"
+#include <math.h>
+
+static void setEntry(u8* rgba, u32 age, float r, float g, float b)
+{
+	rgba[age * 4 + 0] = (u8)(r * 255.0f + 0.5f);
+	rgba[age * 4 + 1] = (u8)(g * 255.0f + 0.5f);
+	rgba[age * 4 + 2] = (u8)(b * 255.0f + 0.5f);
+	rgba[age * 4 + 3] = 255;
+}
+
+void fillPalette(Palette palette, u8* rgba)
+{
+	setEntry(rgba, 0, 0.0f, 0.0f, 0.0f);
+	for (u32 age = 1; age < PALETTE_SIZE; age++)
+	{
+		switch (palette)
+		{
+			case PALETTE_GRAY:
+			{
+				// a step of gray for each colour band
+				float level = ageBand(age) * 0.25f;
+				setEntry(rgba, age, level, level, level);
+			} break;
+			case PALETTE_HEAT:
+			{
+				// newborn cells are white hot and cool to dark red on a log scale
+				float t = logf((float)age) / logf((float)(PALETTE_SIZE - 1));
+				float r = 1.0f - 0.5f * t * t;
+				float g = t < 0.5f ? 1.0f - 1.6f * t : 0.2f * (1.0f - t);
+				float b = t < 0.25f ? 1.0f - 4.0f * t : 0.0f;
+				setEntry(rgba, age, r, g, b);
+			} break;
+			case PALETTE_MONO:
+			{
+				setEntry(rgba, age, 1.0f, 1.0f, 1.0f);
+			} break;
+			default:
+			{
+			} break;
+		}
+	}
+}
+
+const char* paletteName(Palette palette)
+{
+	switch (palette)
+	{
+		case PALETTE_GRAY:
+		{
+			return "gray";
+		} break;
+		case PALETTE_HEAT:
+		{
+			return "heat";
+		} break;
+		case PALETTE_MONO:
+		{
+			return "mono";
+		} break;
+		default:
+		{
+		} break;
+	}
+	return "";
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "common.h"
+#include "options.h"
+
+// age to colour tables the renderer looks cells up in, one rgba8 entry an
+// age. cells older than the table use its last entry, dead cells the first.
+// ages only go up to the band starts when the board is uploaded as bands.
+static const u32 PALETTE_SIZE = 128;
+
+// fills PALETTE_SIZE * 4 bytes
+void fillPalette(Palette palette, u8* rgba);
+const char* paletteName(Palette palette);
@@ -0,0 +1,735 @@
+#include "patterns.h"
+#include "life.h"
+#include "macrocell.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+static const u64 MIN_PATTERN_CHUNK_SIZE = 1024 * 1024;
+
+static bool isDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isRleTag(char c)
+{
+	return c == '$' || c == '!' || c == '.' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static const char* nextLine(const char* cursor, const char* end)
+{
+	const char* newline = (const char*)memchr(cursor, '\n', end - cursor);
+	return newline ? newline + 1 : end;
+}
+
+// chunks may only start right after a tag, a run count never spans them
+static const char* resyncRle(const char* cursor, const char* end)
+{
+	while (cursor != end && !isRleTag(*cursor))
+	{
+		cursor++;
+	}
+	return cursor == end ? end : cursor + 1;
+}
+
+static void splitChunks(Pattern* pattern, const char* begin, const char* end, const char* (*resync)(const char*, const char*))
+{
+	u64 size = end - begin;
+	u64 threads = std::thread::hardware_concurrency();
+	u64 count = size / MIN_PATTERN_CHUNK_SIZE;
+	count = count < threads ? count : threads;
+	count = count ? count : 1;
+
+	pattern->chunks.clear();
+	const char* chunkBegin = begin;
+	for (u64 i = 1; i <= count; i++)
+	{
+		const char* chunkEnd = i == count ? end : resync(begin + size * i / count, end);
+		if (chunkEnd < chunkBegin)
+		{
+			chunkEnd = chunkBegin;
+		}
+		PatternChunk chunk = {};
+		chunk.begin = chunkBegin;
+		chunk.end = chunkEnd;
+		pattern->chunks.push_back(chunk);
+		chunkBegin = chunkEnd;
+	}
+}
+
+template<typename Function>
+static void forEachChunk(std::vector<PatternChunk>& chunks, Function function)
+{
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunks.size(); i++)
+	{
+		workers.push_back(std::thread(function, &chunks[i]));
+	}
+	function(&chunks[0]);
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+}
+
+// rle: <count><tag> items, b is dead, $ ends a row, ! ends the pattern and
+// every other tag is a live state
+template<bool emit>
+static void parseRle(PatternChunk* chunk, PatternRunCallback callback, void* user)
+{
+	u64 count = 0;
+	u64 x = emit ? chunk->startX : 0;
+	u64 y = emit ? chunk->startY : 0;
+	u64 rows = 0;
+	chunk->lastAliveRow = -1;
+
+	for (const char* cursor = chunk->begin; cursor != chunk->end; cursor++)
+	{
+		char c = *cursor;
+		if (isDigit(c))
+		{
+			count = count * 10 + (c - '0');
+			continue;
+		}
+		if (isSpace(c))
+		{
+			continue;
+		}
+
+		u64 run = count ? count : 1;
+		count = 0;
+		if (c == '!')
+		{
+			chunk->terminated = true;
+			break;
+		}
+		else if (c == '$')
+		{
+			rows += run;
+			y += run;
+			x = 0;
+		}
+		else if (c == 'b' || c == '.')
+		{
+			x += run;
+		}
+		else if (isRleTag(c))
+		{
+			if (emit)
+			{
+				callback(user, x, y, run);
+			}
+			x += run;
+			chunk->lastAliveRow = rows;
+			if (rows == 0)
+			{
+				chunk->firstRowWidth = x > chunk->firstRowWidth ? x : chunk->firstRowWidth;
+			}
+			else
+			{
+				chunk->width = x > chunk->width ? x : chunk->width;
+			}
+		}
+	}
+
+	chunk->rows = rows;
+	chunk->endX = x;
+}
+
+static void measureRle(PatternChunk* chunk)
+{
+	parseRle<false>(chunk, NULL, NULL);
+}
+
+static void combineRle(Pattern* pattern)
+{
+	u64 x = 0;
+	u64 y = 0;
+	bool terminated = false;
+	for (size_t i = 0; i < pattern->chunks.size(); i++)
+	{
+		PatternChunk& chunk = pattern->chunks[i];
+		chunk.ignored = terminated;
+		if (terminated)
+		{
+			continue;
+		}
+
+		chunk.startX = x;
+		chunk.startY = y;
+		if (chunk.firstRowWidth && x + chunk.firstRowWidth > pattern->width)
+		{
+			pattern->width = x + chunk.firstRowWidth;
+		}
+		pattern->width = chunk.width > pattern->width ? chunk.width : pattern->width;
+		if (chunk.lastAliveRow >= 0 && y + chunk.lastAliveRow + 1 > pattern->height)
+		{
+			pattern->height = y + chunk.lastAliveRow + 1;
+		}
+
+		if (chunk.rows)
+		{
+			x = chunk.endX;
+			y += chunk.rows;
+		}
+		else
+		{
+			x += chunk.endX;
+		}
+		terminated = chunk.terminated;
+	}
+}
+
+// plaintext: ! starts a comment line, every other line is a row where O or *
+// is a live cell
+template<bool emit>
+static void parsePlaintext(PatternChunk* chunk, PatternRunCallback callback, void* user)
+{
+	u64 rows = 0;
+	chunk->lastAliveRow = -1;
+
+	for (const char* line = chunk->begin; line != chunk->end; line = nextLine(line, chunk->end))
+	{
+		if (*line == '!')
+		{
+			continue;
+		}
+
+		const char* lineEnd = nextLine(line, chunk->end);
+		u64 runStart = 0;
+		u64 runLength = 0;
+		u64 x = 0;
+		for (const char* cursor = line; cursor != lineEnd && *cursor != '\n' && *cursor != '\r'; cursor++, x++)
+		{
+			if (*cursor == 'O' || *cursor == '*')
+			{
+				runStart = runLength ? runStart : x;
+				runLength++;
+				chunk->width = x + 1 > chunk->width ? x + 1 : chunk->width;
+				chunk->lastAliveRow = rows;
+			}
+			else if (runLength)
+			{
+				if (emit)
+				{
+					callback(user, runStart, chunk->startY + rows, runLength);
+				}
+				runLength = 0;
+			}
+		}
+		if (emit && runLength)
+		{
+			callback(user, runStart, chunk->startY + rows, runLength);
+		}
+		rows++;
+	}
+
+	chunk->rows = rows;
+}
+
+static void measurePlaintext(PatternChunk* chunk)
+{
+	parsePlaintext<false>(chunk, NULL, NULL);
+}
+
+static void combinePlaintext(Pattern* pattern)
+{
+	u64 y = 0;
+	for (size_t i = 0; i < pattern->chunks.size(); i++)
+	{
+		PatternChunk& chunk = pattern->chunks[i];
+		chunk.startY = y;
+		pattern->width = chunk.width > pattern->width ? chunk.width : pattern->width;
+		if (chunk.lastAliveRow >= 0 && y + chunk.lastAliveRow + 1 > pattern->height)
+		{
+			pattern->height = y + chunk.lastAliveRow + 1;
+		}
+		y += chunk.rows;
+	}
+}
+
+static bool parseInteger(const char** cursor, const char* end, i64* value)
+{
+	const char* c = *cursor;
+	while (c != end && (*c == ' ' || *c == '\t'))
+	{
+		c++;
+	}
+	bool negative = c != end && *c == '-';
+	if (c != end && (*c == '-' || *c == '+'))
+	{
+		c++;
+	}
+	if (c == end || !isDigit(*c))
+	{
+		return false;
+	}
+
+	i64 result = 0;
+	while (c != end && isDigit(*c))
+	{
+		result = result * 10 + (*c - '0');
+		c++;
+	}
+	*value = negative ? -result : result;
+	*cursor = c;
+	return true;
+}
+
+// life 1.06: # starts a comment line, every other line is the x y of a live cell
+template<bool emit>
+static void parseLife106(PatternChunk* chunk, PatternRunCallback callback, void* user, i64 originX, i64 originY)
+{
+	chunk->minX = chunk->minY = INT64_MAX;
+	chunk->maxX = chunk->maxY = INT64_MIN;
+
+	for (const char* line = chunk->begin; line != chunk->end; line = nextLine(line, chunk->end))
+	{
+		const char* cursor = line;
+		i64 x, y;
+		if (*line == '#' || !parseInteger(&cursor, chunk->end, &x) || !parseInteger(&cursor, chunk->end, &y))
+		{
+			continue;
+		}
+
+		if (emit)
+		{
+			callback(user, x - originX, y - originY, 1);
+		}
+		chunk->minX = x < chunk->minX ? x : chunk->minX;
+		chunk->minY = y < chunk->minY ? y : chunk->minY;
+		chunk->maxX = x > chunk->maxX ? x : chunk->maxX;
+		chunk->maxY = y > chunk->maxY ? y : chunk->maxY;
+	}
+}
+
+static void measureLife106(PatternChunk* chunk)
+{
+	parseLife106<false>(chunk, NULL, NULL, 0, 0);
+}
+
+static void combineLife106(Pattern* pattern)
+{
+	i64 minX = INT64_MAX, minY = INT64_MAX, maxX = INT64_MIN, maxY = INT64_MIN;
+	for (size_t i = 0; i < pattern->chunks.size(); i++)
+	{
+		const PatternChunk& chunk = pattern->chunks[i];
+		minX = chunk.minX < minX ? chunk.minX : minX;
+		minY = chunk.minY < minY ? chunk.minY : minY;
+		maxX = chunk.maxX > maxX ? chunk.maxX : maxX;
+		maxY = chunk.maxY > maxY ? chunk.maxY : maxY;
+	}
+	if (minX <= maxX)
+	{
+		pattern->originX = minX;
+		pattern->originY = minY;
+		pattern->width = maxX - minX + 1;
+		pattern->height = maxY - minY + 1;
+	}
+}
+
+static bool hasExtension(const char* path, const char* extension)
+{
+	size_t pathLength = strlen(path);
+	size_t extensionLength = strlen(extension);
+	if (pathLength < extensionLength)
+	{
+		return false;
+	}
+	const char* a = path + pathLength - extensionLength;
+	for (size_t i = 0; i < extensionLength; i++)
+	{
+		char c = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+		if (c != extension[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static PatternFormat detectFormat(const char* path, const char* begin, const char* end)
+{
+	if (isMacrocell((const u8*)begin, end - begin))
+	{
+		return PATTERN_MACROCELL;
+	}
+	if (end - begin >= 10 && memcmp(begin, "#Life 1.06", 10) == 0)
+	{
+		return PATTERN_LIFE_106;
+	}
+	if (hasExtension(path, ".cells"))
+	{
+		return PATTERN_PLAINTEXT;
+	}
+	if (hasExtension(path, ".rle"))
+	{
+		return PATTERN_RLE;
+	}
+
+	// otherwise go by the first line that isn't a comment
+	for (const char* line = begin; line != end; line = nextLine(line, end))
+	{
+		if (*line == '!' || *line == '.' || *line == 'O')
+		{
+			return PATTERN_PLAINTEXT;
+		}
+		if (*line != '#')
+		{
+			break;
+		}
+	}
+	return PATTERN_RLE;
+}
+
+bool openPattern(const char* path, Pattern* pattern)
+{
+	if (!mapFile(path, &pattern->file))
+	{
+		return false;
+	}
+
+	const char* begin = (const char*)pattern->file.data;
+	const char* end = begin + pattern->file.size;
+	pattern->format = detectFormat(path, begin, end);
+	pattern->width = 0;
+	pattern->height = 0;
+	pattern->originX = 0;
+	pattern->originY = 0;
+
+	switch (pattern->format)
+	{
+		case PATTERN_RLE:
+		{
+			// skip the comments and the x = m, y = n header
+			const char* data = begin;
+			while (data != end)
+			{
+				const char* c = data;
+				while (c != end && (*c == ' ' || *c == '\t'))
+				{
+					c++;
+				}
+				if (c == end || (*c != '#' && *c != 'x'))
+				{
+					break;
+				}
+				data = nextLine(data, end);
+			}
+			splitChunks(pattern, data, end, resyncRle);
+			forEachChunk(pattern->chunks, measureRle);
+			combineRle(pattern);
+		} break;
+		case PATTERN_LIFE_106:
+		{
+			splitChunks(pattern, begin, end, nextLine);
+			forEachChunk(pattern->chunks, measureLife106);
+			combineLife106(pattern);
+		} break;
+		case PATTERN_PLAINTEXT:
+		{
+			splitChunks(pattern, begin, end, nextLine);
+			forEachChunk(pattern->chunks, measurePlaintext);
+			combinePlaintext(pattern);
+		} break;
+		case PATTERN_MACROCELL:
+		{
+			unmapFile(&pattern->file);
+			if (!loadMacrocell(path, &pattern->tree))
+			{
+				return false;
+			}
+			QuadBounds bounds = quadTreeBounds(&pattern->tree);
+			if (!bounds.empty)
+			{
+				pattern->originX = bounds.minX;
+				pattern->originY = bounds.minY;
+				pattern->width = bounds.maxX - bounds.minX + 1;
+				pattern->height = bounds.maxY - bounds.minY + 1;
+			}
+		} break;
+	}
+	return true;
+}
+
+struct PatternWindow
+{
+	u64 x;
+	u64 y;
+	PatternRunCallback callback;
+	void* user;
+};
+
+static void offsetRun(void* user, u64 x, u64 y, u64 length)
+{
+	PatternWindow* window = (PatternWindow*)user;
+	window->callback(window->user, window->x + x, window->y + y, length);
+}
+
+void readPatternWindow(const Pattern* pattern, u64 x, u64 y, u64 width, u64 height, PatternRunCallback callback, void* user)
+{
+	if (pattern->format != PATTERN_MACROCELL)
+	{
+		readPattern(pattern, callback, user);
+		return;
+	}
+
+	PatternWindow window;
+	window.x = x;
+	window.y = y;
+	window.callback = callback;
+	window.user = user;
+	flattenQuadTree(&pattern->tree, pattern->originX + x, pattern->originY + y, width, height, offsetRun, &window);
+}
+
+void readPattern(const Pattern* pattern, PatternRunCallback callback, void* user)
+{
+	std::vector<PatternChunk> chunks = pattern->chunks;
+	i64 originX = pattern->originX;
+	i64 originY = pattern->originY;
+	switch (pattern->format)
+	{
+		case PATTERN_RLE:
+		{
+			forEachChunk(chunks, [callback, user](PatternChunk* chunk)
+			{
+				if (!chunk->ignored)
+				{
+					parseRle<true>(chunk, callback, user);
+				}
+			});
+		} break;
+		case PATTERN_LIFE_106:
+		{
+			forEachChunk(chunks, [callback, user, originX, originY](PatternChunk* chunk)
+			{
+				parseLife106<true>(chunk, callback, user, originX, originY);
+			});
+		} break;
+		case PATTERN_PLAINTEXT:
+		{
+			forEachChunk(chunks, [callback, user](PatternChunk* chunk)
+			{
+				parsePlaintext<true>(chunk, callback, user);
+			});
+		} break;
+		case PATTERN_MACROCELL:
+		{
+			readPatternWindow(pattern, 0, 0, pattern->width, pattern->height, callback, user);
+		} break;
+	}
+}
+
+void closePattern(Pattern* pattern)
+{
+	unmapFile(&pattern->file);
+	pattern->chunks.clear();
+	initQuadTree(&pattern->tree);
+}
+
+struct LifePatternTarget
+{
+	u32* ages;
+	u32 width;
+	u32 height;
+	// board cell of the pattern's top left
+	i64 left;
+	i64 top;
+};
+
+static void writeLifeRun(void* user, u64 x, u64 y, u64 length)
+{
+	LifePatternTarget* target = (LifePatternTarget*)user;
+	i64 boardY = target->top - (i64)y;
+	if (boardY < 1 || boardY >= (i64)target->height - 1)
+	{
+		return;
+	}
+
+	// the border stays dead, clip to the cells that get simulated
+	i64 first = target->left + (i64)x;
+	i64 last = first + (i64)length;
+	first = first < 1 ? 1 : first;
+	last = last > (i64)target->width - 1 ? (i64)target->width - 1 : last;
+	u32* row = target->ages + (u64)boardY * target->width;
+	for (i64 i = first; i < last; i++)
+	{
+		row[i] = 1;
+	}
+}
+
+bool loadPattern(const char* path, Life* life, u32 width, u32 height, bool grow)
+{
+	Pattern pattern;
+	if (!openPattern(path, &pattern))
+	{
+		return false;
+	}
+
+	u64 neededWidth = pattern.width + 2 > width ? pattern.width + 2 : width;
+	u64 neededHeight = pattern.height + 2 > height ? pattern.height + 2 : height;
+	if (grow && neededWidth <= 0xffffffff && neededHeight <= 0xffffffff &&
+		neededWidth * neededHeight <= 0xffffffffull / sizeof(u32))
+	{
+		width = (u32)neededWidth;
+		height = (u32)neededHeight;
+	}
+	else if (pattern.width + 2 > width || pattern.height + 2 > height)
+	{
+		printf("%s is %llu x %llu, clipping it to the board\n", path, pattern.width, pattern.height);
+	}
+
+	initLife(life, width, height);
+	LifePatternTarget target;
+	target.ages = currentAges(life);
+	target.width = width;
+	target.height = height;
+	target.left = ((i64)width - (i64)pattern.width) / 2;
+	target.top = ((i64)height + (i64)pattern.height) / 2 - 1;
+
+	// only the part of the pattern that lands inside the border is read
+	i64 windowX = 1 - target.left > 0 ? 1 - target.left : 0;
+	i64 windowY = target.top - ((i64)height - 2) > 0 ? target.top - ((i64)height - 2) : 0;
+	i64 windowRight = (i64)width - 1 - target.left;
+	i64 windowBottom = target.top - 1;
+	if (windowRight > windowX && windowBottom >= windowY)
+	{
+		readPatternWindow(&pattern, windowX, windowY, windowRight - windowX, windowBottom - windowY + 1, writeLifeRun, &target);
+	}
+
+	closePattern(&pattern);
+	return true;
+}
+
+bool canSavePattern(const char* path)
+{
+	return hasExtension(path, ".mc") || hasExtension(path, ".rle");
+}
+
+// rle lines are kept under 70 characters like other editors write them
+static const u32 RLE_LINE_LENGTH = 70;
+
+struct RleWriter
+{
+	FILE* file;
+	u32 lineLength;
+};
+
+static void writeRleRun(RleWriter* writer, u64 count, char tag)
+{
+	char text[24];
+	int length = count > 1 ? snprintf(text, sizeof(text), "%llu%c", count, tag) : snprintf(text, sizeof(text), "%c", tag);
+	if (writer->lineLength + length > RLE_LINE_LENGTH)
+	{
+		fputc('\n', writer->file);
+		writer->lineLength = 0;
+	}
+	fwrite(text, 1, length, writer->file);
+	writer->lineLength += length;
+}
+
+static bool saveRle(const char* path, const Life* life)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	// only the bounding box of the live cells is written
+	const u32* ages = currentAges(life);
+	u32 minX = life->width;
+	u32 minY = life->height;
+	u32 maxX = 0;
+	u32 maxY = 0;
+	for (u32 y = 0; y < life->height; y++)
+	{
+		for (u32 x = 0; x < life->width; x++)
+		{
+			if (ages[x + y * life->width])
+			{
+				minX = x < minX ? x : minX;
+				maxX = x > maxX ? x : maxX;
+				minY = y < minY ? y : minY;
+				maxY = y > maxY ? y : maxY;
+			}
+		}
+	}
+
+	bool empty = minX > maxX;
+	fprintf(file, "x = %u, y = %u, rule = B23/S23\n", empty ? 0 : maxX - minX + 1, empty ? 0 : maxY - minY + 1);
+	RleWriter writer = { file, 0 };
+	u64 emptyRows = 0;
+	for (u32 row = 0; !empty && row <= maxY - minY; row++)
+	{
+		// rle rows run top down, board rows bottom up
+		const u32* cells = ages + (maxY - row) * life->width;
+		u64 run = 0;
+		bool alive = false;
+		bool rowEmpty = true;
+		for (u32 x = minX; x <= maxX; x++)
+		{
+			bool cell = cells[x] != 0;
+			if (cell != alive && run)
+			{
+				if (rowEmpty && emptyRows)
+				{
+					writeRleRun(&writer, emptyRows, '$');
+					emptyRows = 0;
+				}
+				writeRleRun(&writer, run, alive ? 'o' : 'b');
+				rowEmpty = false;
+				run = 0;
+			}
+			alive = cell;
+			run++;
+		}
+		if (alive)
+		{
+			if (rowEmpty && emptyRows)
+			{
+				writeRleRun(&writer, emptyRows, '$');
+				emptyRows = 0;
+			}
+			writeRleRun(&writer, run, 'o');
+			rowEmpty = false;
+		}
+		// trailing dead cells are implied, row ends are written with the next live run
+		emptyRows++;
+	}
+	writeRleRun(&writer, 1, '!');
+	fputc('\n', file);
+
+	bool ok = !ferror(file);
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		printf("failed to write %s\n", path);
+	}
+	return ok;
+}
+
+bool savePattern(const char* path, const Life* life)
+{
+	if (hasExtension(path, ".mc"))
+	{
+		QuadTree tree;
+		buildQuadTree(&tree, currentAges(life), life->width, life->height);
+		return saveMacrocell(path, &tree);
+	}
+	if (hasExtension(path, ".rle"))
+	{
+		return saveRle(path, life);
+	}
+
+	printf("don't know how to save %s\n", path);
+	return false;
+}
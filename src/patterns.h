@@ -0,0 +1,75 @@
+#pragma once
+
+#include "common.h"
+#include "platform.h"
+#include "quadtree.h"
+#include <vector>
+
+struct Life;
+
+enum PatternFormat
+{
+	PATTERN_RLE,
+	PATTERN_LIFE_106,
+	PATTERN_PLAINTEXT,
+	PATTERN_MACROCELL,
+};
+
+// one slice of the mapped file, parsed on its own thread. the first pass
+// measures each chunk relative to where it starts, the prefix over those
+// summaries gives every chunk its absolute starting cell for the second pass.
+struct PatternChunk
+{
+	const char* begin;
+	const char* end;
+
+	// measured by the first pass
+	u64 rows;
+	u64 endX;
+	u64 firstRowWidth;
+	u64 width;
+	i64 lastAliveRow;
+	i64 minX;
+	i64 minY;
+	i64 maxX;
+	i64 maxY;
+	bool terminated;
+	bool ignored;
+
+	// starting cell for the second pass
+	u64 startX;
+	u64 startY;
+};
+
+struct Pattern
+{
+	MappedFile file;
+	PatternFormat format;
+	std::vector<PatternChunk> chunks;
+	// macrocells stay a tree and are only flattened where they are read
+	QuadTree tree;
+
+	// bounding box of the live cells, cells are reported relative to its top left
+	u64 width;
+	u64 height;
+	i64 originX;
+	i64 originY;
+};
+
+// called concurrently from the parser threads with runs of live cells, x to
+// the right and y downwards. runs from different calls never overlap.
+typedef void (*PatternRunCallback)(void* user, u64 x, u64 y, u64 length);
+
+bool openPattern(const char* path, Pattern* pattern);
+void readPattern(const Pattern* pattern, PatternRunCallback callback, void* user);
+// only guarantees the cells inside the window are reported, formats that can
+// skip the rest do
+void readPatternWindow(const Pattern* pattern, u64 x, u64 y, u64 width, u64 height, PatternRunCallback callback, void* user);
+void closePattern(Pattern* pattern);
+
+// loads a pattern centered on the board. with grow set the board is enlarged
+// to fit the pattern, otherwise the pattern is clipped.
+bool loadPattern(const char* path, Life* life, u32 width, u32 height, bool grow);
+// picks the format from the extension, .rle or .mc
+bool savePattern(const char* path, const Life* life);
+bool canSavePattern(const char* path);
@@ -0,0 +1,315 @@
+#include "platform.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool mapFile(const char* path, MappedFile* file)
+{
+	*file = {};
+	HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(fileHandle, &size) || size.QuadPart == 0)
+	{
+		printf("failed to map empty file %s\n", path);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappingHandle)
+	{
+		printf("failed to map %s\n", path);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file->data = (const u8*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!file->data)
+	{
+		printf("failed to map %s\n", path);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+	file->size = size.QuadPart;
+	file->fileHandle = fileHandle;
+	file->mappingHandle = mappingHandle;
+	return true;
+}
+
+void unmapFile(MappedFile* file)
+{
+	if (file->data)
+	{
+		UnmapViewOfFile(file->data);
+		CloseHandle(file->mappingHandle);
+		CloseHandle(file->fileHandle);
+	}
+	*file = {};
+}
+
+bool syncFile(FILE* file)
+{
+	if (fflush(file) != 0)
+	{
+		return false;
+	}
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	return handle != INVALID_HANDLE_VALUE && FlushFileBuffers(handle);
+}
+
+bool replaceFile(const char* from, const char* to)
+{
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+bool makeDirectory(const char* path)
+{
+	return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+FILE* takeStdout()
+{
+	static FILE* taken = NULL;
+	if (taken)
+	{
+		return taken;
+	}
+	fflush(stdout);
+	int fd = _dup(_fileno(stdout));
+	if (fd < 0)
+	{
+		return NULL;
+	}
+	_dup2(_fileno(stderr), _fileno(stdout));
+	_setmode(fd, _O_BINARY);
+	taken = _fdopen(fd, "wb");
+	return taken;
+}
+
+bool openWritableFile(const char* path, u64 size, WritableFile* file)
+{
+	*file = {};
+	HANDLE fileHandle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	DWORD returned = 0;
+	DeviceIoControl(fileHandle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &returned, NULL);
+
+	LARGE_INTEGER currentSize;
+	GetFileSizeEx(fileHandle, &currentSize);
+	if ((u64)currentSize.QuadPart < size)
+	{
+		LARGE_INTEGER newSize;
+		newSize.QuadPart = size;
+		if (!SetFilePointerEx(fileHandle, newSize, NULL, FILE_BEGIN) || !SetEndOfFile(fileHandle))
+		{
+			printf("failed to grow %s\n", path);
+			CloseHandle(fileHandle);
+			return false;
+		}
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, NULL);
+	if (!mappingHandle)
+	{
+		printf("failed to map %s\n", path);
+		CloseHandle(fileHandle);
+		return false;
+	}
+	file->size = size;
+	file->fileHandle = fileHandle;
+	file->mappingHandle = mappingHandle;
+	return true;
+}
+
+void closeWritableFile(WritableFile* file)
+{
+	if (file->fileHandle)
+	{
+		CloseHandle(file->mappingHandle);
+		CloseHandle(file->fileHandle);
+	}
+	*file = {};
+}
+
+void* mapFileRange(WritableFile* file, u64 offset, u64 size)
+{
+	return MapViewOfFile(file->mappingHandle, FILE_MAP_READ | FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, (SIZE_T)size);
+}
+
+void unmapFileRange(void* data, u64 size)
+{
+	UnmapViewOfFile(data);
+}
+
+void flushFileRange(void* data, u64 size)
+{
+	FlushViewOfFile(data, (SIZE_T)size);
+}
+
+void prefetchFileRange(void* data, u64 size)
+{
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = data;
+	range.NumberOfBytes = (SIZE_T)size;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool mapFile(const char* path, MappedFile* file)
+{
+	*file = {};
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		printf("failed to map empty file %s\n", path);
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		printf("failed to map %s\n", path);
+		close(fd);
+		return false;
+	}
+	file->data = (const u8*)data;
+	file->size = info.st_size;
+	file->fd = fd;
+	return true;
+}
+
+void unmapFile(MappedFile* file)
+{
+	if (file->data)
+	{
+		munmap((void*)file->data, file->size);
+		close(file->fd);
+	}
+	*file = {};
+}
+
+bool syncFile(FILE* file)
+{
+	if (fflush(file) != 0)
+	{
+		return false;
+	}
+	return fsync(fileno(file)) == 0;
+}
+
+bool replaceFile(const char* from, const char* to)
+{
+	return rename(from, to) == 0;
+}
+
+bool makeDirectory(const char* path)
+{
+	return mkdir(path, 0777) == 0 || errno == EEXIST;
+}
+
+FILE* takeStdout()
+{
+	static FILE* taken = NULL;
+	if (taken)
+	{
+		return taken;
+	}
+	fflush(stdout);
+	int fd = dup(STDOUT_FILENO);
+	if (fd < 0)
+	{
+		return NULL;
+	}
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+	taken = fdopen(fd, "wb");
+	return taken;
+}
+
+bool openWritableFile(const char* path, u64 size, WritableFile* file)
+{
+	*file = {};
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+	{
+		printf("failed to open %s\n", path);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || ((u64)info.st_size < size && ftruncate(fd, size) != 0))
+	{
+		printf("failed to grow %s\n", path);
+		close(fd);
+		return false;
+	}
+	file->size = size;
+	file->fd = fd;
+	return true;
+}
+
+void closeWritableFile(WritableFile* file)
+{
+	if (file->size)
+	{
+		close(file->fd);
+	}
+	*file = {};
+}
+
+void* mapFileRange(WritableFile* file, u64 offset, u64 size)
+{
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, offset);
+	return data == MAP_FAILED ? NULL : data;
+}
+
+void unmapFileRange(void* data, u64 size)
+{
+	munmap(data, size);
+}
+
+void flushFileRange(void* data, u64 size)
+{
+	msync(data, size, MS_ASYNC);
+}
+
+void prefetchFileRange(void* data, u64 size)
+{
+	madvise(data, size, MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common.h"
+#include <stdio.h>
+
+// read only view of a whole file
+struct MappedFile
+{
+	const u8* data;
+	u64 size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+};
+
+bool mapFile(const char* path, MappedFile* file);
+void unmapFile(MappedFile* file);
+
+// flushes a stdio file all the way to the disk
+bool syncFile(FILE* file);
+// atomically moves from over to, replacing any existing file
+bool replaceFile(const char* from, const char* to);
+// creates a directory, true when it already exists
+bool makeDirectory(const char* path);
+// hands back the process's standard output as a binary stream and points
+// stdout at stderr, so messages printed afterwards don't end up in the data.
+// later calls return the same stream.
+FILE* takeStdout();
+
+// read write file that is mapped a range at a time. ranges have to start on
+// a multiple of FILE_MAPPING_ALIGNMENT.
+static const u64 FILE_MAPPING_ALIGNMENT = 64 * 1024;
+
+struct WritableFile
+{
+	u64 size;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fd;
+#endif
+};
+
+// opens or creates the file and grows it to size, the new space stays sparse
+bool openWritableFile(const char* path, u64 size, WritableFile* file);
+void closeWritableFile(WritableFile* file);
+void* mapFileRange(WritableFile* file, u64 offset, u64 size);
+void unmapFileRange(void* data, u64 size);
+// starts writing dirty pages back without waiting for them
+void flushFileRange(void* data, u64 size);
+// hints that the range is about to be read
+void prefetchFileRange(void* data, u64 size);
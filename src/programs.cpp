@@ -0,0 +1,255 @@
+#include "programs.h"
+#include "platform.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// fnv-1a
+static u64 hashBytes(u64 hash, const void* data, size_t size)
+{
+	const u8* bytes = (const u8*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static u64 hashString(u64 hash, const char* text)
+{
+	text = text ? text : "";
+	return hashBytes(hash, text, strlen(text) + 1);
+}
+
+static bool programBinariesSupported()
+{
+	if (!glGetProgramBinary || !glProgramBinary || !glProgramParameteri)
+	{
+		return false;
+	}
+	if (!hasGLVersion(4, 1) && !hasGLExtension("GL_ARB_get_program_binary"))
+	{
+		return false;
+	}
+	// drivers that can't hand binaries back say so with no formats
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+void initProgramCache(ProgramCache* cache, const char* directory)
+{
+	cache->directory = NULL;
+	if (directory && programBinariesSupported())
+	{
+		if (makeDirectory(directory))
+		{
+			cache->directory = directory;
+		}
+		else
+		{
+			printf("failed to create the shader cache %s\n", directory);
+		}
+	}
+
+	u64 key = 0xcbf29ce484222325ull;
+	key = hashString(key, (const char*)glGetString(GL_VENDOR));
+	key = hashString(key, (const char*)glGetString(GL_RENDERER));
+	key = hashString(key, (const char*)glGetString(GL_VERSION));
+	key = hashString(key, (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
+	cache->driverKey = key;
+
+	cache->parallel = glMaxShaderCompilerThreads &&
+		(hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile"));
+	if (cache->parallel)
+	{
+		// as many threads as the driver wants
+		glMaxShaderCompilerThreads(0xffffffff);
+	}
+	cache->hits = 0;
+	cache->compiles = 0;
+	cache->writes = 0;
+}
+
+static std::string cachePath(const ProgramCache* cache, u64 key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+	return std::string(cache->directory) + name;
+}
+
+static bool loadBinary(const ProgramCache* cache, PendingProgram* pending)
+{
+	if (!cache->directory)
+	{
+		return false;
+	}
+	// a miss is the usual first run, it isn't reported
+	FILE* file = fopen(cachePath(cache, pending->key).c_str(), "rb");
+	if (!file)
+	{
+		return false;
+	}
+	ProgramCacheHeader header;
+	std::vector<u8> binary;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == PROGRAM_CACHE_MAGIC &&
+		header.version == PROGRAM_CACHE_VERSION &&
+		header.key == pending->key &&
+		header.size > 0;
+	if (ok)
+	{
+		binary.resize(header.size);
+		ok = fread(binary.data(), header.size, 1, file) == 1;
+	}
+	fclose(file);
+	if (!ok)
+	{
+		return false;
+	}
+
+	glProgramBinary(pending->program, header.format, binary.data(), header.size);
+	GLint status = GL_FALSE;
+	glGetProgramiv(pending->program, GL_LINK_STATUS, &status);
+	return status == GL_TRUE;
+}
+
+static void writeBinary(ProgramCache* cache, const PendingProgram* pending)
+{
+	GLint length = 0;
+	glGetProgramiv(pending->program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+	{
+		return;
+	}
+	std::vector<u8> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(pending->program, length, &length, &format, binary.data());
+
+	ProgramCacheHeader header = {};
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.format = format;
+	header.size = (u32)length;
+	header.key = pending->key;
+
+	// written aside and moved over, so a reader never maps half a binary
+	std::string path = cachePath(cache, pending->key);
+	std::string tempPath = path + ".tmp";
+	FILE* file = fopen(tempPath.c_str(), "wb");
+	if (!file)
+	{
+		printf("failed to write the shader cache %s\n", path.c_str());
+		return;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(binary.data(), length, 1, file) == 1;
+	ok = fclose(file) == 0 && ok;
+	if (!ok || !replaceFile(tempPath.c_str(), path.c_str()))
+	{
+		printf("failed to write the shader cache %s\n", path.c_str());
+		remove(tempPath.c_str());
+		return;
+	}
+	cache->writes++;
+}
+
+static void beginStages(ProgramCache* cache, PendingProgram* pending, const GLenum* stages, const char** codes, u32 count)
+{
+	u64 key = cache->driverKey;
+	for (u32 i = 0; i < count; i++)
+	{
+		key = hashBytes(key, &stages[i], sizeof(stages[i]));
+		key = hashString(key, codes[i]);
+	}
+	pending->key = key;
+	pending->shaderCount = 0;
+	pending->program = glCreateProgram();
+	pending->cached = loadBinary(cache, pending);
+	if (pending->cached)
+	{
+		cache->hits++;
+		return;
+	}
+
+	// a rejected binary leaves the program failed, start over with a fresh one
+	glDeleteProgram(pending->program);
+	pending->program = glCreateProgram();
+	// nothing here asks for a status, so the compiles and the link are only queued
+	for (u32 i = 0; i < count; i++)
+	{
+		u32 shader = glCreateShader(stages[i]);
+		glShaderSource(shader, 1, &codes[i], NULL);
+		glCompileShader(shader);
+		glAttachShader(pending->program, shader);
+		pending->shaders[pending->shaderCount++] = shader;
+	}
+	if (cache->directory)
+	{
+		glProgramParameteri(pending->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(pending->program);
+	cache->compiles++;
+}
+
+void beginProgram(ProgramCache* cache, PendingProgram* pending, const char* vertexCode, const char* fragmentCode)
+{
+	GLenum stages[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+	const char* codes[] = {vertexCode, fragmentCode};
+	beginStages(cache, pending, stages, codes, 2);
+}
+
+void beginComputeProgram(ProgramCache* cache, PendingProgram* pending, const char* computeCode)
+{
+	GLenum stage = GL_COMPUTE_SHADER;
+	beginStages(cache, pending, &stage, &computeCode, 1);
+}
+
+u32 finishProgram(ProgramCache* cache, PendingProgram* pending)
+{
+	if (pending->cached)
+	{
+		return pending->program;
+	}
+
+	// the first status asked for waits on the driver
+	char log[1024] = {};
+	bool built = true;
+	for (u32 i = 0; i < pending->shaderCount; i++)
+	{
+		GLint status = GL_FALSE;
+		glGetShaderiv(pending->shaders[i], GL_COMPILE_STATUS, &status);
+		if (status == GL_FALSE)
+		{
+			glGetShaderInfoLog(pending->shaders[i], sizeof(log), NULL, log);
+			printf("shader failed to compile\n%s\n", log);
+			built = false;
+		}
+	}
+	GLint status = GL_FALSE;
+	glGetProgramiv(pending->program, GL_LINK_STATUS, &status);
+	if (built && status == GL_FALSE)
+	{
+		glGetProgramInfoLog(pending->program, sizeof(log), NULL, log);
+		printf("program failed to link\n%s\n", log);
+		built = false;
+	}
+	for (u32 i = 0; i < pending->shaderCount; i++)
+	{
+		glDetachShader(pending->program, pending->shaders[i]);
+		glDeleteShader(pending->shaders[i]);
+	}
+	pending->shaderCount = 0;
+
+	if (!built)
+	{
+		glDeleteProgram(pending->program);
+		return 0;
+	}
+	if (cache->directory)
+	{
+		writeBinary(cache, pending);
+	}
+	return pending->program;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common.h"
+#include "glext.h"
+
+// builds gl programs, keeping the linked binaries on disk. a program's file is
+// named after a hash of its sources and the driver that built it, so an
+// edited shader or a driver update just misses, and a binary the driver
+// turns down anyway is compiled again. misses are only queued by
+// beginProgram and waited on by finishProgram, with KHR_parallel_shader_compile
+// the driver builds every program started in between on its own threads.
+static const u32 PROGRAM_CACHE_MAGIC = 0x5047434c; // "LCGP"
+static const u32 PROGRAM_CACHE_VERSION = 1;
+static const char* const DEFAULT_SHADER_CACHE = "shader-cache";
+static const u32 MAX_PROGRAM_STAGES = 2;
+
+struct ProgramCacheHeader
+{
+	u32 magic;
+	u32 version;
+	u32 format;
+	u32 size;
+	u64 key;
+};
+
+struct ProgramCache
+{
+	// NULL when nothing is read or written
+	const char* directory;
+	// the driver's strings, every program key starts from it
+	u64 driverKey;
+	bool parallel;
+
+	u64 hits;
+	u64 compiles;
+	u64 writes;
+};
+
+struct PendingProgram
+{
+	u32 program;
+	u32 shaders[MAX_PROGRAM_STAGES];
+	u32 shaderCount;
+	u64 key;
+	bool cached;
+};
+
+// directory can be NULL, it's created when it doesn't exist. needs a current
+// context and loadGLExtensions.
+void initProgramCache(ProgramCache* cache, const char* directory);
+void beginProgram(ProgramCache* cache, PendingProgram* pending, const char* vertexCode, const char* fragmentCode);
+void beginComputeProgram(ProgramCache* cache, PendingProgram* pending, const char* computeCode);
+// waits for the program and writes it to the cache, 0 when it didn't build
+u32 finishProgram(ProgramCache* cache, PendingProgram* pending);
@@ -0,0 +1,100 @@
+#include "pyramid.h"
+#include "life.h"
+#include <stddef.h>
+
+void initPyramid(DensityPyramid* pyramid, u32 width, u32 height, const u32* ages)
+{
+	pyramid->width = width;
+	pyramid->height = height;
+	pyramid->tileColumns = (width + DIRTY_TILE_WIDTH - 1) / DIRTY_TILE_WIDTH;
+	pyramid->tileRows = (height + DIRTY_TILE_HEIGHT - 1) / DIRTY_TILE_HEIGHT;
+	pyramid->levelCount = 0;
+
+	u64 levelWidth = width;
+	u64 levelHeight = height;
+	while ((levelWidth > 1 || levelHeight > 1) && pyramid->levelCount < MAX_PYRAMID_LEVELS)
+	{
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+		PyramidLevel* level = &pyramid->levels[pyramid->levelCount++];
+		level->width = (u32)levelWidth;
+		level->height = (u32)levelHeight;
+		level->tileColumns = (level->width + DIRTY_TILE_WIDTH - 1) / DIRTY_TILE_WIDTH;
+		level->tileRows = (level->height + DIRTY_TILE_HEIGHT - 1) / DIRTY_TILE_HEIGHT;
+		level->bands.assign((size_t)level->width * level->height, 0);
+	}
+	updatePyramid(pyramid, ages, NULL, true);
+}
+
+void pyramidLevelTiles(const DensityPyramid* pyramid, u32 level, const u8* dirty, std::vector<u8>* tiles)
+{
+	const PyramidLevel* target = &pyramid->levels[level];
+	u32 shift = level + 1;
+	tiles->assign((size_t)target->tileColumns * target->tileRows, 0);
+	for (u32 y = 0; y < pyramid->tileRows; y++)
+	{
+		const u8* row = dirty + (size_t)y * pyramid->tileColumns;
+		u8* levelRow = tiles->data() + (size_t)(y >> shift) * target->tileColumns;
+		for (u32 x = 0; x < pyramid->tileColumns; x++)
+		{
+			levelRow[x >> shift] |= row[x];
+		}
+	}
+}
+
+// the largest of the 2x2 blocks or cells under a block
+static u8 poolBlock(const DensityPyramid* pyramid, u32 level, const u32* ages, u32 x, u32 y)
+{
+	u32 belowWidth = level ? pyramid->levels[level - 1].width : pyramid->width;
+	u32 belowHeight = level ? pyramid->levels[level - 1].height : pyramid->height;
+	u32 endX = 2 * x + 2 < belowWidth ? 2 * x + 2 : belowWidth;
+	u32 endY = 2 * y + 2 < belowHeight ? 2 * y + 2 : belowHeight;
+	u32 band = 0;
+	for (u32 j = 2 * y; j < endY; j++)
+	{
+		for (u32 i = 2 * x; i < endX; i++)
+		{
+			u32 value = level ? pyramid->levels[level - 1].bands[(size_t)j * belowWidth + i] : ageBand(ages[(size_t)j * belowWidth + i]);
+			band = value > band ? value : band;
+		}
+	}
+	return (u8)band;
+}
+
+void updatePyramid(DensityPyramid* pyramid, const u32* ages, const u8* dirty, bool allDirty)
+{
+	// each level reads the one below, so they are rebuilt bottom up
+	for (u32 i = 0; i < pyramid->levelCount; i++)
+	{
+		PyramidLevel* level = &pyramid->levels[i];
+		if (allDirty)
+		{
+			pyramid->tiles.assign((size_t)level->tileColumns * level->tileRows, 1);
+		}
+		else
+		{
+			pyramidLevelTiles(pyramid, i, dirty, &pyramid->tiles);
+		}
+
+		for (u32 tileY = 0; tileY < level->tileRows; tileY++)
+		{
+			for (u32 tileX = 0; tileX < level->tileColumns; tileX++)
+			{
+				if (!pyramid->tiles[(size_t)tileY * level->tileColumns + tileX])
+				{
+					continue;
+				}
+				u32 endX = (tileX + 1) * DIRTY_TILE_WIDTH < level->width ? (tileX + 1) * DIRTY_TILE_WIDTH : level->width;
+				u32 endY = (tileY + 1) * DIRTY_TILE_HEIGHT < level->height ? (tileY + 1) * DIRTY_TILE_HEIGHT : level->height;
+				for (u32 y = tileY * DIRTY_TILE_HEIGHT; y < endY; y++)
+				{
+					u8* bands = level->bands.data() + (size_t)y * level->width;
+					for (u32 x = tileX * DIRTY_TILE_WIDTH; x < endX; x++)
+					{
+						bands[x] = poolBlock(pyramid, i, ages, x, y);
+					}
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "common.h"
+#include <vector>
+
+// max pooled colour bands of the board in blocks of 2x2, 4x4, ... cells, so a
+// zoomed out view reads about one texel a pixel. level i holds blocks of
+// 2^(i + 1) cells a side. levels are split into tiles of DIRTY_TILE_WIDTH x
+// DIRTY_TILE_HEIGHT texels like the board, so board tile (x, y) lands in tile
+// (x >> (i + 1), y >> (i + 1)) of level i and dirty tiles carry straight over.
+static const u32 MAX_PYRAMID_LEVELS = 30;
+
+// colour bands of the renderer, by the lowest age in each
+static const u32 NUM_AGE_BANDS = 5;
+static const u32 AGE_BAND_STARTS[NUM_AGE_BANDS] = {0, 1, 2, 11, 101};
+
+struct PyramidLevel
+{
+	u32 width;
+	u32 height;
+	u32 tileColumns;
+	u32 tileRows;
+	std::vector<u8> bands;
+};
+
+struct DensityPyramid
+{
+	u32 width;
+	u32 height;
+	u32 tileColumns;
+	u32 tileRows;
+	// levels down to a single block
+	u32 levelCount;
+	PyramidLevel levels[MAX_PYRAMID_LEVELS];
+	std::vector<u8> tiles;
+};
+
+inline u32 ageBand(u32 age)
+{
+	u32 band = 0;
+	for (u32 i = 1; i < NUM_AGE_BANDS; i++)
+	{
+		band += age >= AGE_BAND_STARTS[i];
+	}
+	return band;
+}
+
+void initPyramid(DensityPyramid* pyramid, u32 width, u32 height, const u32* ages);
+// rebuilds the blocks over the board's dirty tiles, every block with allDirty
+void updatePyramid(DensityPyramid* pyramid, const u32* ages, const u8* dirty, bool allDirty);
+// one byte a tile of the level, set where the board's dirty tiles land
+void pyramidLevelTiles(const DensityPyramid* pyramid, u32 level, const u8* dirty, std::vector<u8>* tiles);
@@ -0,0 +1,243 @@
+#include "quadtree.h"
+#include <assert.h>
+
+void initQuadTree(QuadTree* tree)
+{
+	tree->nodes.clear();
+	tree->lookup.clear();
+	tree->nodes.push_back(QuadNode());
+	tree->root = QUAD_EMPTY;
+	tree->level = QUAD_LEAF_LEVEL;
+}
+
+static u32 internNode(QuadTree* tree, const QuadNode& node)
+{
+	QuadKey key;
+	key.level = node.level;
+	key.bits = node.bits;
+	for (u32 i = 0; i < 4; i++)
+	{
+		key.children[i] = node.children[i];
+	}
+
+	std::unordered_map<QuadKey, u32, QuadKeyHash>::const_iterator found = tree->lookup.find(key);
+	if (found != tree->lookup.end())
+	{
+		return found->second;
+	}
+
+	u32 index = (u32)tree->nodes.size();
+	tree->nodes.push_back(node);
+	tree->lookup[key] = index;
+	return index;
+}
+
+u32 makeQuadLeaf(QuadTree* tree, u64 bits)
+{
+	if (!bits)
+	{
+		return QUAD_EMPTY;
+	}
+
+	QuadNode node = {};
+	node.level = QUAD_LEAF_LEVEL;
+	node.bits = bits;
+	node.population = popCount(bits);
+	return internNode(tree, node);
+}
+
+u32 makeQuadNode(QuadTree* tree, u32 level, u32 nw, u32 ne, u32 sw, u32 se)
+{
+	assert(level > QUAD_LEAF_LEVEL);
+	if (!nw && !ne && !sw && !se)
+	{
+		return QUAD_EMPTY;
+	}
+
+	QuadNode node = {};
+	node.level = level;
+	node.children[QUAD_NW] = nw;
+	node.children[QUAD_NE] = ne;
+	node.children[QUAD_SW] = sw;
+	node.children[QUAD_SE] = se;
+	for (u32 i = 0; i < 4; i++)
+	{
+		node.population += tree->nodes[node.children[i]].population;
+	}
+	return internNode(tree, node);
+}
+
+QuadBounds quadTreeBounds(const QuadTree* tree)
+{
+	// children are always created before their parents, so one pass in
+	// creation order sees every child's bounds before it is needed
+	std::vector<QuadBounds> bounds(tree->nodes.size());
+	bounds[QUAD_EMPTY].empty = true;
+	for (size_t i = 1; i < tree->nodes.size(); i++)
+	{
+		const QuadNode& node = tree->nodes[i];
+		QuadBounds& result = bounds[i];
+		result.empty = true;
+
+		if (node.level == QUAD_LEAF_LEVEL)
+		{
+			for (u32 bit = 0; bit < 64; bit++)
+			{
+				if (node.bits & (1ull << bit))
+				{
+					u64 x = bit % 8;
+					u64 y = bit / 8;
+					result.minX = result.empty || x < result.minX ? x : result.minX;
+					result.minY = result.empty || y < result.minY ? y : result.minY;
+					result.maxX = result.empty || x > result.maxX ? x : result.maxX;
+					result.maxY = result.empty || y > result.maxY ? y : result.maxY;
+					result.empty = false;
+				}
+			}
+			continue;
+		}
+
+		u64 half = 1ull << (node.level - 1);
+		for (u32 child = 0; child < 4; child++)
+		{
+			const QuadBounds& childBounds = bounds[node.children[child]];
+			if (childBounds.empty)
+			{
+				continue;
+			}
+			u64 offsetX = child == QUAD_NE || child == QUAD_SE ? half : 0;
+			u64 offsetY = child == QUAD_SW || child == QUAD_SE ? half : 0;
+			u64 minX = childBounds.minX + offsetX;
+			u64 minY = childBounds.minY + offsetY;
+			u64 maxX = childBounds.maxX + offsetX;
+			u64 maxY = childBounds.maxY + offsetY;
+			result.minX = result.empty || minX < result.minX ? minX : result.minX;
+			result.minY = result.empty || minY < result.minY ? minY : result.minY;
+			result.maxX = result.empty || maxX > result.maxX ? maxX : result.maxX;
+			result.maxY = result.empty || maxY > result.maxY ? maxY : result.maxY;
+			result.empty = false;
+		}
+	}
+	return bounds[tree->root];
+}
+
+struct QuadWindow
+{
+	u64 x;
+	u64 y;
+	u64 width;
+	u64 height;
+	QuadRunCallback callback;
+	void* user;
+};
+
+static void flattenNode(const QuadTree* tree, const QuadWindow& window, u32 index, u32 level, u64 nodeX, u64 nodeY)
+{
+	u64 size = 1ull << level;
+	if (index == QUAD_EMPTY ||
+		nodeX >= window.x + window.width || nodeX + size <= window.x ||
+		nodeY >= window.y + window.height || nodeY + size <= window.y)
+	{
+		return;
+	}
+
+	const QuadNode& node = tree->nodes[index];
+	if (level > QUAD_LEAF_LEVEL)
+	{
+		u64 half = size / 2;
+		flattenNode(tree, window, node.children[QUAD_NW], level - 1, nodeX, nodeY);
+		flattenNode(tree, window, node.children[QUAD_NE], level - 1, nodeX + half, nodeY);
+		flattenNode(tree, window, node.children[QUAD_SW], level - 1, nodeX, nodeY + half);
+		flattenNode(tree, window, node.children[QUAD_SE], level - 1, nodeX + half, nodeY + half);
+		return;
+	}
+
+	for (u64 row = 0; row < 8; row++)
+	{
+		u64 y = nodeY + row;
+		if (y < window.y || y >= window.y + window.height)
+		{
+			continue;
+		}
+
+		u32 bits = (u32)(node.bits >> (row * 8)) & 0xff;
+		u64 column = 0;
+		while (column < 8)
+		{
+			if (!(bits & (1u << column)))
+			{
+				column++;
+				continue;
+			}
+			u64 start = column;
+			while (column < 8 && (bits & (1u << column)))
+			{
+				column++;
+			}
+
+			u64 first = nodeX + start > window.x ? nodeX + start : window.x;
+			u64 last = nodeX + column < window.x + window.width ? nodeX + column : window.x + window.width;
+			if (first < last)
+			{
+				window.callback(window.user, first - window.x, y - window.y, last - first);
+			}
+		}
+	}
+}
+
+void flattenQuadTree(const QuadTree* tree, u64 x, u64 y, u64 width, u64 height, QuadRunCallback callback, void* user)
+{
+	QuadWindow window;
+	window.x = x;
+	window.y = y;
+	window.width = width;
+	window.height = height;
+	window.callback = callback;
+	window.user = user;
+	flattenNode(tree, window, tree->root, tree->level, 0, 0);
+}
+
+static u32 buildNode(QuadTree* tree, const u32* ages, u32 width, u32 height, u32 level, u64 nodeX, u64 nodeY)
+{
+	if (nodeX >= width || nodeY >= height)
+	{
+		return QUAD_EMPTY;
+	}
+
+	if (level == QUAD_LEAF_LEVEL)
+	{
+		u64 bits = 0;
+		for (u64 row = 0; row < 8 && nodeY + row < height; row++)
+		{
+			// tree rows run top down, board rows bottom up
+			const u32* boardRow = ages + (height - 1 - (nodeY + row)) * (u64)width;
+			for (u64 column = 0; column < 8 && nodeX + column < width; column++)
+			{
+				if (boardRow[nodeX + column])
+				{
+					bits |= 1ull << (column + row * 8);
+				}
+			}
+		}
+		return makeQuadLeaf(tree, bits);
+	}
+
+	u64 half = 1ull << (level - 1);
+	u32 nw = buildNode(tree, ages, width, height, level - 1, nodeX, nodeY);
+	u32 ne = buildNode(tree, ages, width, height, level - 1, nodeX + half, nodeY);
+	u32 sw = buildNode(tree, ages, width, height, level - 1, nodeX, nodeY + half);
+	u32 se = buildNode(tree, ages, width, height, level - 1, nodeX + half, nodeY + half);
+	return makeQuadNode(tree, level, nw, ne, sw, se);
+}
+
+void buildQuadTree(QuadTree* tree, const u32* ages, u32 width, u32 height)
+{
+	initQuadTree(tree);
+	u32 level = QUAD_LEAF_LEVEL;
+	while ((1ull << level) < width || (1ull << level) < height)
+	{
+		level++;
+	}
+	tree->level = level;
+	tree->root = buildNode(tree, ages, width, height, level, 0, 0);
+}
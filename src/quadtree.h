@@ -0,0 +1,90 @@
+#pragma once
+
+#include "common.h"
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+
+// hash consed quadtree, identical subtrees are stored once. level 3 nodes are
+// 8x8 leaves with bit (column + row * 8) set for live cells, row 0 at the top.
+// a level n node covers 2^n x 2^n cells. node 0 is the empty node of every level.
+static const u32 QUAD_LEAF_LEVEL = 3;
+static const u32 QUAD_EMPTY = 0;
+
+enum QuadChild
+{
+	QUAD_NW,
+	QUAD_NE,
+	QUAD_SW,
+	QUAD_SE,
+};
+
+struct QuadNode
+{
+	u32 level;
+	u32 children[4];
+	u64 bits;
+	u64 population;
+};
+
+struct QuadKey
+{
+	u32 level;
+	u32 children[4];
+	u64 bits;
+
+	bool operator==(const QuadKey& other) const
+	{
+		return level == other.level && bits == other.bits &&
+			children[0] == other.children[0] && children[1] == other.children[1] &&
+			children[2] == other.children[2] && children[3] == other.children[3];
+	}
+};
+
+struct QuadKeyHash
+{
+	size_t operator()(const QuadKey& key) const
+	{
+		u64 hash = key.bits * 0x9e3779b97f4a7c15ull + key.level;
+		for (u32 i = 0; i < 4; i++)
+		{
+			hash = (hash ^ key.children[i]) * 0x100000001b3ull;
+		}
+		return (size_t)(hash ^ (hash >> 32));
+	}
+};
+
+struct QuadTree
+{
+	std::vector<QuadNode> nodes;
+	std::unordered_map<QuadKey, u32, QuadKeyHash> lookup;
+	u32 root;
+	u32 level;
+};
+
+struct QuadBounds
+{
+	u64 minX;
+	u64 minY;
+	u64 maxX;
+	u64 maxY;
+	bool empty;
+};
+
+// called with runs of live cells, x to the right and y downwards
+typedef void (*QuadRunCallback)(void* user, u64 x, u64 y, u64 length);
+
+void initQuadTree(QuadTree* tree);
+u32 makeQuadLeaf(QuadTree* tree, u64 bits);
+u32 makeQuadNode(QuadTree* tree, u32 level, u32 nw, u32 ne, u32 sw, u32 se);
+
+// bounds of the live cells under the root, relative to the root's top left.
+// visits every unique node once.
+QuadBounds quadTreeBounds(const QuadTree* tree);
+
+// reports the live cells inside the given window of the tree, relative to the
+// window. subtrees outside the window or empty are never visited.
+void flattenQuadTree(const QuadTree* tree, u64 x, u64 y, u64 width, u64 height, QuadRunCallback callback, void* user);
+
+// builds a tree from a row major age buffer, row 0 is the bottom of the board
+void buildQuadTree(QuadTree* tree, const u32* ages, u32 width, u32 height);
@@ -0,0 +1,422 @@
+#include "recording.h"
+#include "life.h"
+#include <assert.h>
+#include <string.h>
+
+static const u32 RECORDER_WRITE_BUFFER_SIZE = 4 * 1024 * 1024;
+static const u64 NO_FRAME = ~0ull;
+
+static void writeVarint(std::vector<u8>* out, u32 value)
+{
+	while (value >= 0x80)
+	{
+		out->push_back((u8)(value | 0x80));
+		value >>= 7;
+	}
+	out->push_back((u8)value);
+}
+
+static bool readVarint(const u8** cursor, const u8* end, u32* value)
+{
+	u32 result = 0;
+	for (u32 shift = 0; shift < 32; shift += 7)
+	{
+		if (*cursor == end)
+		{
+			return false;
+		}
+		u8 byte = *(*cursor)++;
+		result |= (u32)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void encodeDelta(const u32* previous, const u32* cells, u32 count, std::vector<u8>* out)
+{
+	out->clear();
+	u32 last = 0;
+	for (u32 i = 0; i < count; i++)
+	{
+		if ((previous[i] != 0) != (cells[i] != 0))
+		{
+			writeVarint(out, i - last);
+			last = i;
+		}
+	}
+}
+
+static bool writeBytes(Recorder* recorder, const void* data, size_t size)
+{
+	if (fwrite(data, 1, size, recorder->file) != size)
+	{
+		if (!recorder->failed)
+		{
+			printf("failed to write recording\n");
+		}
+		recorder->failed = true;
+		return false;
+	}
+	recorder->offset += size;
+	return true;
+}
+
+static void writeFrame(Recorder* recorder, const std::vector<u32>& cells)
+{
+	u64 frameIndex = recorder->offsets.size();
+	bool keyframe = frameIndex % recorder->keyframeInterval == 0;
+
+	RecordingFrame frame = {};
+	const void* payload = NULL;
+	if (keyframe)
+	{
+		frame.kind = RECORDING_KEYFRAME;
+		frame.size = recorder->cellCount * sizeof(u32);
+		payload = cells.data();
+	}
+	else
+	{
+		encodeDelta(recorder->previous.data(), cells.data(), recorder->cellCount, &recorder->encoded);
+		frame.kind = RECORDING_DELTA;
+		frame.size = (u32)recorder->encoded.size();
+		payload = recorder->encoded.data();
+	}
+
+	static const u8 padding[4] = {};
+	recorder->offsets.push_back(recorder->offset);
+	writeBytes(recorder, &frame, sizeof(frame));
+	writeBytes(recorder, payload, frame.size);
+	writeBytes(recorder, padding, (4 - frame.size % 4) % 4);
+}
+
+static void writerThread(Recorder* recorder)
+{
+	std::unique_lock<std::mutex> guard(recorder->lock);
+	for (;;)
+	{
+		recorder->wake.wait(guard, [recorder] { return recorder->stopping || !recorder->pending.empty(); });
+		if (recorder->pending.empty())
+		{
+			break;
+		}
+
+		std::vector<u32> cells = std::move(recorder->pending.front());
+		recorder->pending.pop_front();
+		guard.unlock();
+		recorder->drained.notify_one();
+
+		writeFrame(recorder, cells);
+		recorder->previous.swap(cells);
+
+		guard.lock();
+		recorder->spare.push_back(std::move(cells));
+	}
+}
+
+bool openRecorder(Recorder* recorder, const char* path, const Life* life, u32 keyframeInterval)
+{
+	recorder->file = fopen(path, "wb");
+	if (!recorder->file)
+	{
+		printf("failed to open recording %s\n", path);
+		return false;
+	}
+	setvbuf(recorder->file, NULL, _IOFBF, RECORDER_WRITE_BUFFER_SIZE);
+
+	recorder->cellCount = cellCount(life);
+	recorder->keyframeInterval = keyframeInterval ? keyframeInterval : DEFAULT_KEYFRAME_INTERVAL;
+	recorder->stopping = false;
+	recorder->stalls = 0;
+	recorder->pending.clear();
+	u64 frameBytes = (u64)recorder->cellCount * sizeof(u32);
+	u64 maxPending = RECORDER_MAX_PENDING_BYTES / frameBytes;
+	recorder->maxPending = maxPending > 2 ? (u32)maxPending : 2;
+	recorder->spare.clear();
+	recorder->previous.clear();
+	recorder->offsets.clear();
+	recorder->offset = 0;
+	recorder->failed = false;
+
+	RecordingHeader header = {};
+	header.magic = RECORDING_MAGIC;
+	header.version = RECORDING_VERSION;
+	header.width = life->width;
+	header.height = life->height;
+	header.keyframeInterval = recorder->keyframeInterval;
+	header.firstGeneration = life->generation;
+	writeBytes(recorder, &header, sizeof(header));
+
+	recorder->writer = std::thread(writerThread, recorder);
+	return true;
+}
+
+void recordGeneration(Recorder* recorder, const Life* life)
+{
+	assert(cellCount(life) == recorder->cellCount);
+
+	std::vector<u32> cells;
+	{
+		std::lock_guard<std::mutex> guard(recorder->lock);
+		if (!recorder->spare.empty())
+		{
+			cells = std::move(recorder->spare.back());
+			recorder->spare.pop_back();
+		}
+	}
+
+	const u32* ages = currentAges(life);
+	cells.assign(ages, ages + recorder->cellCount);
+
+	{
+		// every generation is recorded, a writer that falls behind holds the simulation back
+		std::unique_lock<std::mutex> guard(recorder->lock);
+		if (recorder->pending.size() >= recorder->maxPending)
+		{
+			recorder->stalls++;
+			recorder->drained.wait(guard, [recorder] { return recorder->pending.size() < recorder->maxPending; });
+		}
+		recorder->pending.push_back(std::move(cells));
+	}
+	recorder->wake.notify_one();
+}
+
+void closeRecorder(Recorder* recorder)
+{
+	{
+		std::lock_guard<std::mutex> guard(recorder->lock);
+		recorder->stopping = true;
+	}
+	recorder->wake.notify_one();
+	recorder->writer.join();
+
+	static const u8 padding[8] = {};
+	writeBytes(recorder, padding, (8 - recorder->offset % 8) % 8);
+
+	RecordingFooter footer = {};
+	footer.indexOffset = recorder->offset;
+	footer.frameCount = recorder->offsets.size();
+	footer.magic = RECORDING_INDEX_MAGIC;
+	writeBytes(recorder, recorder->offsets.data(), recorder->offsets.size() * sizeof(u64));
+	writeBytes(recorder, &footer, sizeof(footer));
+
+	fclose(recorder->file);
+	recorder->file = NULL;
+	recorder->spare.clear();
+	recorder->previous.clear();
+	recorder->encoded.clear();
+}
+
+// walks the frames from the header on, for a recording without a footer
+static void rebuildIndex(Replay* replay)
+{
+	const u8* data = replay->file.data;
+	u64 size = replay->file.size;
+	u64 keyframeSize = (u64)replay->header.width * replay->header.height * sizeof(u32);
+	u64 offset = sizeof(RecordingHeader);
+	replay->rebuiltIndex.clear();
+	while (size - offset >= sizeof(RecordingFrame))
+	{
+		RecordingFrame frame;
+		memcpy(&frame, data + offset, sizeof(frame));
+		u64 padded = ((u64)frame.size + 3) & ~3ull;
+		bool keyframe = replay->rebuiltIndex.size() % replay->header.keyframeInterval == 0;
+		bool valid = keyframe ? frame.kind == RECORDING_KEYFRAME && frame.size == keyframeSize : frame.kind == RECORDING_DELTA;
+		if (!valid || padded > size - offset - sizeof(frame))
+		{
+			break;
+		}
+		replay->rebuiltIndex.push_back(offset);
+		offset += sizeof(frame) + padded;
+	}
+	replay->indexOffset = offset;
+	replay->frameCount = replay->rebuiltIndex.size();
+}
+
+bool openReplay(Replay* replay, const char* path)
+{
+	if (!mapFile(path, &replay->file))
+	{
+		return false;
+	}
+
+	const u8* data = replay->file.data;
+	u64 size = replay->file.size;
+	RecordingFooter footer;
+	if (size < sizeof(RecordingHeader) + sizeof(RecordingFooter))
+	{
+		printf("recording %s is truncated\n", path);
+		closeReplay(replay);
+		return false;
+	}
+	memcpy(&replay->header, data, sizeof(RecordingHeader));
+	memcpy(&footer, data + size - sizeof(RecordingFooter), sizeof(RecordingFooter));
+
+	const RecordingHeader& header = replay->header;
+	if (header.magic != RECORDING_MAGIC || header.version != RECORDING_VERSION)
+	{
+		printf("%s is not a recording\n", path);
+		closeReplay(replay);
+		return false;
+	}
+	if (header.width < 3 || header.height < 3 || header.keyframeInterval == 0)
+	{
+		printf("recording %s has a corrupt header\n", path);
+		closeReplay(replay);
+		return false;
+	}
+	replay->frame = NO_FRAME;
+	replay->rebuiltIndex.clear();
+
+	if (footer.magic != RECORDING_INDEX_MAGIC)
+	{
+		rebuildIndex(replay);
+		if (replay->frameCount == 0)
+		{
+			printf("recording %s was not closed and has no whole frames\n", path);
+			closeReplay(replay);
+			return false;
+		}
+		printf("recording %s was not closed, %llu frames recovered\n", path, replay->frameCount);
+		return true;
+	}
+	if (footer.frameCount == 0 || footer.indexOffset > size - sizeof(RecordingFooter) ||
+		footer.frameCount > (size - sizeof(RecordingFooter) - footer.indexOffset) / sizeof(u64))
+	{
+		printf("recording %s has a corrupt index\n", path);
+		closeReplay(replay);
+		return false;
+	}
+
+	replay->indexOffset = footer.indexOffset;
+	replay->frameCount = footer.frameCount;
+	return true;
+}
+
+static bool readFrame(const Replay* replay, u64 frameIndex, RecordingFrame* frame, const u8** payload)
+{
+	u64 offset;
+	if (replay->rebuiltIndex.empty())
+	{
+		memcpy(&offset, replay->file.data + replay->indexOffset + frameIndex * sizeof(u64), sizeof(u64));
+	}
+	else
+	{
+		offset = replay->rebuiltIndex[frameIndex];
+	}
+	if (offset > replay->indexOffset || replay->indexOffset - offset < sizeof(RecordingFrame))
+	{
+		return false;
+	}
+	memcpy(frame, replay->file.data + offset, sizeof(RecordingFrame));
+	*payload = replay->file.data + offset + sizeof(RecordingFrame);
+	return frame->size <= replay->indexOffset - offset - sizeof(RecordingFrame);
+}
+
+static bool decodeFrame(Replay* replay, u64 frameIndex, u32* ages)
+{
+	RecordingFrame frame;
+	const u8* payload;
+	u32 count = replay->header.width * replay->header.height;
+	if (!readFrame(replay, frameIndex, &frame, &payload))
+	{
+		printf("recording frame %llu is corrupt\n", frameIndex);
+		return false;
+	}
+
+	if (frame.kind == RECORDING_KEYFRAME)
+	{
+		if (frame.size != count * sizeof(u32))
+		{
+			printf("recording keyframe %llu has the wrong size\n", frameIndex);
+			return false;
+		}
+		memcpy(ages, payload, frame.size);
+	}
+	else
+	{
+		// survivors age by one, then the listed cells are born or die
+		for (u32 i = 0; i < count; i++)
+		{
+			ages[i] += ages[i] ? 1 : 0;
+		}
+
+		const u8* cursor = payload;
+		const u8* end = payload + frame.size;
+		u32 cell = 0;
+		while (cursor != end)
+		{
+			u32 gap;
+			if (!readVarint(&cursor, end, &gap) || gap >= count - cell)
+			{
+				printf("recording delta %llu is corrupt\n", frameIndex);
+				return false;
+			}
+			cell += gap;
+			ages[cell] = ages[cell] ? 0 : 1;
+		}
+	}
+
+	replay->frame = frameIndex;
+	return true;
+}
+
+bool seekReplay(Replay* replay, u64 generation, u32* ages)
+{
+	if (generation < replay->header.firstGeneration)
+	{
+		return false;
+	}
+	u64 target = generation - replay->header.firstGeneration;
+	if (target >= replay->frameCount)
+	{
+		return false;
+	}
+
+	// keep decoding forward when the target is in the current keyframe run
+	u64 keyframe = target - target % replay->header.keyframeInterval;
+	u64 frame = replay->frame;
+	if (frame == NO_FRAME || frame < keyframe || frame > target)
+	{
+		if (!decodeFrame(replay, keyframe, ages))
+		{
+			replay->frame = NO_FRAME;
+			return false;
+		}
+		frame = keyframe;
+	}
+
+	while (frame < target)
+	{
+		if (!decodeFrame(replay, ++frame, ages))
+		{
+			replay->frame = NO_FRAME;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool advanceReplay(Replay* replay, u32* ages)
+{
+	if (replay->frame == NO_FRAME)
+	{
+		return seekReplay(replay, replay->header.firstGeneration, ages);
+	}
+	if (replay->frame + 1 >= replay->frameCount)
+	{
+		return false;
+	}
+	return seekReplay(replay, replayGeneration(replay) + 1, ages);
+}
+
+void closeReplay(Replay* replay)
+{
+	unmapFile(&replay->file);
+	replay->frame = NO_FRAME;
+	replay->frameCount = 0;
+	replay->rebuiltIndex.clear();
+}
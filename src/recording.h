@@ -0,0 +1,115 @@
+#pragma once
+
+#include "common.h"
+#include "platform.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+struct Life;
+
+// a recording is a header, one frame per generation and an index footer.
+// every keyframeInterval frames a keyframe stores the raw ages, the frames
+// in between only store the cells whose alive state flipped since the
+// previous generation. the footer holds the file offset of every frame, so
+// any generation is one keyframe plus at most keyframeInterval - 1 deltas away.
+// a recording whose run died before the footer was written has its index
+// rebuilt by walking the frames, up to the last one that was written whole.
+static const u32 RECORDING_MAGIC = 0x5243474c; // "LGCR"
+static const u32 RECORDING_INDEX_MAGIC = 0x4943474c; // "LGCI"
+static const u32 RECORDING_VERSION = 1;
+static const u32 DEFAULT_KEYFRAME_INTERVAL = 64;
+// board copies waiting for the writer are capped at this many bytes, at least
+// two of them. a full queue makes the simulation wait for the writer.
+static const u64 RECORDER_MAX_PENDING_BYTES = 256ull * 1024 * 1024;
+
+enum RecordingFrameKind
+{
+	RECORDING_KEYFRAME = 0,
+	RECORDING_DELTA = 1,
+};
+
+struct RecordingHeader
+{
+	u32 magic;
+	u32 version;
+	u32 width;
+	u32 height;
+	u32 keyframeInterval;
+	u32 reserved;
+	u64 firstGeneration;
+};
+
+// payloads are padded to 4 bytes so keyframe ages stay aligned in the mapping
+struct RecordingFrame
+{
+	u32 kind;
+	u32 size;
+};
+
+struct RecordingFooter
+{
+	u64 indexOffset;
+	u64 frameCount;
+	u32 magic;
+	u32 reserved;
+};
+
+// frames are copied on the simulation thread and encoded and written
+// sequentially on the writer thread
+struct Recorder
+{
+	FILE* file;
+	u32 cellCount;
+	u32 keyframeInterval;
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable wake;
+	// signalled when the writer took a frame off a full queue
+	std::condition_variable drained;
+	std::deque<std::vector<u32>> pending;
+	u32 maxPending;
+	std::vector<std::vector<u32>> spare;
+	bool stopping;
+	// generations that waited for room in the queue
+	u64 stalls;
+
+	// only touched by the writer thread
+	std::vector<u32> previous;
+	std::vector<u8> encoded;
+	std::vector<u64> offsets;
+	u64 offset;
+	bool failed;
+};
+
+bool openRecorder(Recorder* recorder, const char* path, const Life* life, u32 keyframeInterval);
+void recordGeneration(Recorder* recorder, const Life* life);
+void closeRecorder(Recorder* recorder);
+
+struct Replay
+{
+	MappedFile file;
+	RecordingHeader header;
+	// where the frames end, the footer's index starts here
+	u64 indexOffset;
+	u64 frameCount;
+	// the offsets of the frames when the footer is missing and they were found
+	// by walking the file, empty when the footer's index is used
+	std::vector<u64> rebuiltIndex;
+	// frame currently decoded into the caller's ages, ~0 when none
+	u64 frame;
+};
+
+bool openReplay(Replay* replay, const char* path);
+bool seekReplay(Replay* replay, u64 generation, u32* ages);
+bool advanceReplay(Replay* replay, u32* ages);
+void closeReplay(Replay* replay);
+
+inline u64 replayGeneration(const Replay* replay)
+{
+	return replay->header.firstGeneration + replay->frame;
+}
@@ -0,0 +1,86 @@
+#include "scheduler.h"
+
+void initScheduler(Scheduler* scheduler, u32 rate, u64 frequency, u64 now)
+{
+	scheduler->frequency = frequency;
+	scheduler->lastTick = now;
+	scheduler->remainder = 0;
+	scheduler->pending = 0;
+	scheduler->rate = rate;
+}
+
+void setSchedulerRate(Scheduler* scheduler, u32 rate, u64 now)
+{
+	// start the new rate from now rather than replaying the old backlog at it
+	initScheduler(scheduler, rate, scheduler->frequency, now);
+}
+
+void advanceScheduler(Scheduler* scheduler, u64 now)
+{
+	u64 elapsed = now - scheduler->lastTick;
+	scheduler->lastTick = now;
+	if (scheduler->rate == 0)
+	{
+		return;
+	}
+
+	// a stall (window drag, debugger) shouldn't be made up for, a quarter
+	// second of backlog is the most that is ever carried
+	u64 maxBacklog = scheduler->rate / 4 + 1;
+	if (elapsed > scheduler->frequency)
+	{
+		elapsed = scheduler->frequency;
+	}
+
+	u64 due = elapsed * scheduler->rate + scheduler->remainder;
+	scheduler->pending += due / scheduler->frequency;
+	scheduler->remainder = due % scheduler->frequency;
+	if (scheduler->pending > maxBacklog)
+	{
+		scheduler->pending = maxBacklog;
+	}
+}
+
+u64 ticksUntilDue(const Scheduler* scheduler)
+{
+	if (generationDue(scheduler))
+	{
+		return 0;
+	}
+	return (scheduler->frequency - scheduler->remainder + scheduler->rate - 1) / scheduler->rate;
+}
+
+void initFramePacer(FramePacer* pacer, u64 budget)
+{
+	pacer->budget = budget;
+	pacer->stepCost = 0;
+	pacer->publishCost = 0;
+	pacer->generations = 1;
+}
+
+static u64 smooth(u64 average, u64 sample)
+{
+	// the first sample seeds the average, later ones move it an eighth of the
+	// way. a cost that jumped is taken at once so the plan drops with it.
+	if (average == 0 || sample > average * 4)
+	{
+		return sample;
+	}
+	return (u64)((i64)average + ((i64)sample - (i64)average) / 8);
+}
+
+void measureFrame(FramePacer* pacer, u32 generations, u64 stepTicks, u64 publishTicks)
+{
+	if (generations == 0)
+	{
+		return;
+	}
+	pacer->stepCost = smooth(pacer->stepCost, stepTicks / generations + 1);
+	pacer->publishCost = smooth(pacer->publishCost, publishTicks);
+
+	u64 planned = stepBudget(pacer) / pacer->stepCost;
+	u64 limit = (u64)pacer->generations * 2;
+	planned = planned < limit ? planned : limit;
+	planned = planned < MAX_GENERATIONS_PER_FRAME ? planned : MAX_GENERATIONS_PER_FRAME;
+	pacer->generations = planned > 1 ? (u32)planned : 1;
+}
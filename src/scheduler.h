@@ -0,0 +1,69 @@
+#pragma once
+
+#include "common.h"
+
+// fixed timestep scheduler. generations come due at a steady rate measured in
+// timer ticks, independent of how often frames are drawn. a rate of 0 means
+// every generation is always due.
+static const u32 DEFAULT_GENERATION_RATE = 60;
+static const u32 MAX_GENERATION_RATE = 1u << 20;
+static const u32 MAX_GENERATIONS_PER_FRAME = 1u << 16;
+
+struct Scheduler
+{
+	u64 frequency;
+	u64 lastTick;
+	// ticks * rate carried over that didn't add up to a whole generation
+	u64 remainder;
+	// generations that came due but haven't been run
+	u64 pending;
+	u32 rate;
+};
+
+void initScheduler(Scheduler* scheduler, u32 rate, u64 frequency, u64 now);
+void setSchedulerRate(Scheduler* scheduler, u32 rate, u64 now);
+// adds the generations that came due since the last call
+void advanceScheduler(Scheduler* scheduler, u64 now);
+// ticks until the next generation comes due, 0 if one is due now
+u64 ticksUntilDue(const Scheduler* scheduler);
+
+// picks how many generations to run before publishing a frame so that
+// stepping plus publishing fits the frame budget. costs are running averages
+// of what the last frames measured and the plan grows at most 2x per frame.
+// a board that suddenly gets busy is caught by stepBudget, which the batch
+// stops at, so it overshoots by one generation at most. the next plan then
+// starts from the new cost.
+struct FramePacer
+{
+	u64 budget;
+	u64 stepCost;
+	u64 publishCost;
+	u32 generations;
+};
+
+void initFramePacer(FramePacer* pacer, u64 budget);
+inline u32 plannedGenerations(const FramePacer* pacer)
+{
+	return pacer->generations;
+}
+// the ticks a batch of generations may take, what the budget leaves after publishing
+inline u64 stepBudget(const FramePacer* pacer)
+{
+	u64 budget = pacer->budget > pacer->publishCost ? pacer->budget - pacer->publishCost : 0;
+	return budget > 0 ? budget : 1;
+}
+// feeds back what the last frame cost and plans the next one
+void measureFrame(FramePacer* pacer, u32 generations, u64 stepTicks, u64 publishTicks);
+
+inline bool generationDue(const Scheduler* scheduler)
+{
+	return scheduler->rate == 0 || scheduler->pending > 0;
+}
+
+inline void generationDone(Scheduler* scheduler)
+{
+	if (scheduler->pending)
+	{
+		scheduler->pending--;
+	}
+}
@@ -0,0 +1,380 @@
+#include "simulation.h"
+#include "checkpoint.h"
+#include "gpulife.h"
+#include "life.h"
+#include "recording.h"
+#include "tiled.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+// longest sleep between generations, keeps rate changes and stops responsive
+static const u64 MAX_IDLE_MICROSECONDS = 10000;
+
+void initSimulation(Simulation* simulation, Life* life)
+{
+	simulation->life = life;
+	simulation->replay = NULL;
+	simulation->tiled = NULL;
+	simulation->gpu = NULL;
+	simulation->viewX = 0;
+	simulation->viewY = 0;
+	simulation->viewLevel = 0;
+	simulation->extracted.x = 0;
+	simulation->extracted.y = 0;
+	simulation->extracted.level = 0;
+	simulation->recorder = NULL;
+	simulation->checkpointer = NULL;
+	simulation->checkpointInterval = 0;
+	simulation->lastCheckpoint = life->generation;
+	simulation->paused = false;
+	simulation->finished = false;
+	simulation->settleAfter = 0;
+	simulation->settled = false;
+	simulation->wakeRenderer = NULL;
+	simulation->stillGenerations = 0;
+}
+
+// a step without a birth or death left the board as it was, but for the ages
+static void settleBoard(Simulation* simulation)
+{
+	Life* life = simulation->life;
+	bool changed = false;
+	for (size_t i = 0; i < life->dirtyTiles.size() && !changed; i++)
+	{
+		changed = (life->dirtyTiles[i] & TILE_CHANGED) != 0;
+	}
+	simulation->stillGenerations = changed ? 0 : simulation->stillGenerations + 1;
+	if (simulation->stillGenerations >= simulation->settleAfter)
+	{
+		printf("settled at generation %llu\n", life->generation);
+		simulation->stillGenerations = 0;
+		simulation->settled = true;
+	}
+}
+
+bool stepSimulation(Simulation* simulation)
+{
+	Life* life = simulation->life;
+	if (simulation->replay)
+	{
+		if (!advanceReplay(simulation->replay, currentAges(life)))
+		{
+			return false;
+		}
+		life->generation = replayGeneration(simulation->replay);
+	}
+	else if (simulation->tiled)
+	{
+		stepTiledLife(simulation->tiled);
+		life->generation = tiledGeneration(simulation->tiled);
+	}
+	else if (simulation->gpu)
+	{
+		// the host copy is only brought up to date for a checkpoint
+		stepGpuLife(simulation->gpu);
+		life->generation = simulation->gpu->generation;
+		Checkpointer* checkpointer = simulation->checkpointer;
+		if (checkpointer && life->generation - simulation->lastCheckpoint >= simulation->checkpointInterval)
+		{
+			protectCheckpoint(checkpointer, life->ages[(life->current + 1) % NUM_CELL_BUFFERS].data());
+			readGpuLife(simulation->gpu, life);
+			if (beginCheckpoint(checkpointer, life))
+			{
+				simulation->lastCheckpoint = life->generation;
+			}
+		}
+	}
+	else
+	{
+		Checkpointer* checkpointer = simulation->checkpointer;
+		if (checkpointer)
+		{
+			protectCheckpoint(checkpointer, life->ages[(life->current + 1) % NUM_CELL_BUFFERS].data());
+		}
+		stepLife(life);
+		if (simulation->settleAfter)
+		{
+			settleBoard(simulation);
+		}
+		if (simulation->recorder)
+		{
+			recordGeneration(simulation->recorder, life);
+		}
+		for (size_t i = 0; i < simulation->dirty.size(); i++)
+		{
+			simulation->dirty[i] |= life->dirtyTiles[i];
+		}
+		if (checkpointer && life->generation - simulation->lastCheckpoint >= simulation->checkpointInterval && beginCheckpoint(checkpointer, life))
+		{
+			simulation->lastCheckpoint = life->generation;
+		}
+		return true;
+	}
+	// only the host engine knows which tiles it touched
+	simulation->allDirty = true;
+	return true;
+}
+
+// the tiles that changed between the renderer's last frame and this one
+static void collectDirtyTiles(Simulation* simulation, SimulationFrame* frame)
+{
+	u64 sequence = frame->sequence;
+	u32 slot = sequence % DIRTY_HISTORY_SIZE;
+	simulation->dirtyHistory[slot].swap(simulation->dirty);
+	simulation->allDirtyHistory[slot] = simulation->allDirty;
+	simulation->dirty.assign(frame->dirty.size(), 0);
+	simulation->allDirty = false;
+
+	// the renderer only moves forward, a stale value just widens the set
+	u64 consumed = simulation->frames.consumed.load(std::memory_order_acquire);
+	frame->allDirty = sequence - consumed > DIRTY_HISTORY_SIZE;
+	if (frame->allDirty)
+	{
+		return;
+	}
+	memset(frame->dirty.data(), 0, frame->dirty.size());
+	for (u64 s = consumed + 1; s <= sequence && !frame->allDirty; s++)
+	{
+		u32 index = s % DIRTY_HISTORY_SIZE;
+		frame->allDirty = simulation->allDirtyHistory[index];
+		const u8* changed = simulation->dirtyHistory[index].data();
+		for (size_t i = 0; i < frame->dirty.size(); i++)
+		{
+			frame->dirty[i] |= changed[i];
+		}
+	}
+}
+
+void publishFrame(Simulation* simulation)
+{
+	Life* life = simulation->life;
+	FrameExchange* frames = &simulation->frames;
+	SimulationFrame* frame = &frames->slots[frames->back];
+	frame->view.x = 0;
+	frame->view.y = 0;
+	frame->view.level = 0;
+	if (simulation->tiled)
+	{
+		// only what's in view is read, however big the board
+		frame->view.x = simulation->viewX.load(std::memory_order_relaxed);
+		frame->view.y = simulation->viewY.load(std::memory_order_relaxed);
+		frame->view.level = simulation->viewLevel.load(std::memory_order_relaxed);
+		readTiledBlocks(simulation->tiled, frame->view.x, frame->view.y, frame->view.level, life->width, life->height, frame->ages.data());
+		simulation->extracted = frame->view;
+		simulation->allDirty = true;
+	}
+	else
+	{
+		memcpy(frame->ages.data(), currentAges(life), frame->ages.size() * sizeof(u32));
+	}
+	frame->generation = life->generation;
+	frame->sequence = frames->published.load(std::memory_order_relaxed) + 1;
+	collectDirtyTiles(simulation, frame);
+
+	u32 previous = frames->shared.exchange(frames->back | FRAME_FRESH, std::memory_order_acq_rel);
+	frames->back = previous & FRAME_SLOT_MASK;
+	frames->published.fetch_add(1, std::memory_order_relaxed);
+	if (previous & FRAME_FRESH)
+	{
+		frames->dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// taking the lock orders this with a reader between its check and its wait
+	{
+		std::lock_guard<std::mutex> guard(frames->waitLock);
+	}
+	frames->waiting.notify_all();
+	if (simulation->wakeRenderer)
+	{
+		simulation->wakeRenderer();
+	}
+}
+
+bool waitForFrame(Simulation* simulation, u64 microseconds)
+{
+	FrameExchange* frames = &simulation->frames;
+	std::unique_lock<std::mutex> lock(frames->waitLock);
+	return frames->waiting.wait_for(lock, std::chrono::microseconds(microseconds), [simulation] { return frameWaiting(simulation); });
+}
+
+bool acquireFrame(Simulation* simulation, const SimulationFrame** frame)
+{
+	FrameExchange* frames = &simulation->frames;
+	bool fresh = (frames->shared.load(std::memory_order_relaxed) & FRAME_FRESH) != 0;
+	if (fresh)
+	{
+		u32 previous = frames->shared.exchange(frames->front, std::memory_order_acq_rel);
+		frames->front = previous & FRAME_SLOT_MASK;
+		frames->consumed.store(frames->slots[frames->front].sequence, std::memory_order_release);
+	}
+	else
+	{
+		frames->duplicated.fetch_add(1, std::memory_order_relaxed);
+	}
+	*frame = &frames->slots[frames->front];
+	return fresh;
+}
+
+u32 advanceSimulation(Simulation* simulation, u32 limit, u64 budget)
+{
+	Scheduler* scheduler = &simulation->scheduler;
+	u64 now = simulation->timer();
+	u32 rate = simulation->rate.load(std::memory_order_relaxed);
+	if (simulationHeld(simulation))
+	{
+		// the time spent held isn't made up for afterwards
+		setSchedulerRate(scheduler, rate, now);
+		return 0;
+	}
+	if (rate != scheduler->rate)
+	{
+		setSchedulerRate(scheduler, rate, now);
+	}
+	advanceScheduler(scheduler, now);
+
+	u32 stepped = 0;
+	while (stepped < limit && generationDue(scheduler))
+	{
+		if (!stepSimulation(simulation))
+		{
+			simulation->finished = true;
+			break;
+		}
+		generationDone(scheduler);
+		stepped++;
+		if (simulation->settled.load(std::memory_order_relaxed))
+		{
+			break;
+		}
+		// the plan comes from older frames, a board that got busy since is cut short
+		if (budget && simulation->timer() - now >= budget)
+		{
+			break;
+		}
+	}
+	return stepped;
+}
+
+void setSimulationView(Simulation* simulation, u64 x, u64 y, u32 level)
+{
+	bool moved = simulation->viewX.load(std::memory_order_relaxed) != x ||
+		simulation->viewY.load(std::memory_order_relaxed) != y ||
+		simulation->viewLevel.load(std::memory_order_relaxed) != level;
+	simulation->viewX.store(x, std::memory_order_relaxed);
+	simulation->viewY.store(y, std::memory_order_relaxed);
+	simulation->viewLevel.store(level, std::memory_order_relaxed);
+	// a held simulation still extracts a moved view
+	if (moved)
+	{
+		wakeSimulation(simulation);
+	}
+}
+
+// a tiled board moved under the renderer needs a new frame even without a generation
+static bool viewMoved(Simulation* simulation)
+{
+	return simulation->tiled &&
+		(simulation->viewX.load(std::memory_order_relaxed) != simulation->extracted.x ||
+		 simulation->viewY.load(std::memory_order_relaxed) != simulation->extracted.y ||
+		 simulation->viewLevel.load(std::memory_order_relaxed) != simulation->extracted.level);
+}
+
+static void simulationThread(Simulation* simulation)
+{
+	Scheduler* scheduler = &simulation->scheduler;
+	while (simulation->running.load(std::memory_order_relaxed))
+	{
+		u64 start = simulation->timer();
+		u32 stepped = advanceSimulation(simulation, plannedGenerations(&simulation->pacer), stepBudget(&simulation->pacer));
+		if (stepped)
+		{
+			u64 stepEnd = simulation->timer();
+			publishFrame(simulation);
+			measureFrame(&simulation->pacer, stepped, stepEnd - start, simulation->timer() - stepEnd);
+			continue;
+		}
+		if (viewMoved(simulation))
+		{
+			publishFrame(simulation);
+			continue;
+		}
+
+		if (simulationHeld(simulation))
+		{
+			// the last frame stays up until something wakes the thread
+			std::unique_lock<std::mutex> lock(simulation->holdLock);
+			simulation->resumed.wait(lock, [simulation] {
+				return !simulation->running.load(std::memory_order_relaxed) || !simulationHeld(simulation) || viewMoved(simulation);
+			});
+			continue;
+		}
+		u64 wait = ticksUntilDue(scheduler) * 1000000 / scheduler->frequency;
+		std::this_thread::sleep_for(std::chrono::microseconds(wait < MAX_IDLE_MICROSECONDS ? wait : MAX_IDLE_MICROSECONDS));
+	}
+}
+
+void setSimulationClock(Simulation* simulation, u32 rate, u64 (*timer)(), u64 frequency)
+{
+	simulation->timer = timer;
+	simulation->rate = rate;
+	initScheduler(&simulation->scheduler, rate, frequency, timer());
+}
+
+void startSimulation(Simulation* simulation, u32 rate, u64 (*timer)(), u64 frequency, u64 frameBudget)
+{
+	initFramePacer(&simulation->pacer, frameBudget);
+
+	// the frames are only needed with a renderer, stepping on the caller's thread doesn't publish
+	FrameExchange* frames = &simulation->frames;
+	size_t tileCount = simulation->life->dirtyTiles.size();
+	for (u32 i = 0; i < NUM_FRAME_SLOTS; i++)
+	{
+		frames->slots[i].ages.assign(cellCount(simulation->life), 0);
+		frames->slots[i].generation = 0;
+		frames->slots[i].sequence = 0;
+		frames->slots[i].dirty.assign(tileCount, 0);
+		frames->slots[i].allDirty = true;
+		frames->slots[i].view = simulation->extracted;
+	}
+	frames->consumed = 0;
+	frames->front = 0;
+	frames->shared = 1;
+	frames->back = 2;
+	frames->published = 0;
+	frames->dropped = 0;
+	frames->duplicated = 0;
+
+	setSimulationClock(simulation, rate, timer, frequency);
+	simulation->dirty.assign(tileCount, 0);
+	simulation->allDirty = true;
+	for (u32 i = 0; i < DIRTY_HISTORY_SIZE; i++)
+	{
+		simulation->dirtyHistory[i].assign(tileCount, 0);
+		simulation->allDirtyHistory[i] = true;
+	}
+
+	// the renderer always has something to draw
+	publishFrame(simulation);
+	simulation->running = true;
+	simulation->thread = std::thread(simulationThread, simulation);
+}
+
+void wakeSimulation(Simulation* simulation)
+{
+	// taking the lock orders the change with the thread between its check and its wait
+	{
+		std::lock_guard<std::mutex> guard(simulation->holdLock);
+	}
+	simulation->resumed.notify_one();
+}
+
+void stopSimulation(Simulation* simulation)
+{
+	simulation->running = false;
+	wakeSimulation(simulation);
+	if (simulation->thread.joinable())
+	{
+		simulation->thread.join();
+	}
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "common.h"
+#include "scheduler.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Checkpointer;
+struct GpuLife;
+struct Life;
+struct Recorder;
+struct Replay;
+struct TiledLife;
+
+static const u32 NUM_FRAME_SLOTS = 3;
+static const u32 FRAME_SLOT_MASK = 0x3;
+// set on the shared slot when it holds a frame the renderer hasn't taken yet
+static const u32 FRAME_FRESH = 0x4;
+// publishes whose dirty tiles are remembered, a renderer further behind redraws everything
+static const u32 DIRTY_HISTORY_SIZE = 8;
+
+// where a frame sits on the board. texels cover 2^level x 2^level cells from
+// x and y, only tiled frames are anything but the whole board at level 0.
+struct FrameView
+{
+	u64 x;
+	u64 y;
+	u32 level;
+};
+
+struct SimulationFrame
+{
+	std::vector<u32> ages;
+	u64 generation;
+	FrameView view;
+	// counts publishes, starting at 1
+	u64 sequence;
+	// tiles that changed since the frame the renderer took last, see Life.
+	// allDirty means every tile did.
+	std::vector<u8> dirty;
+	bool allDirty;
+};
+
+// triple buffer between the simulation and the renderer. each side owns one
+// slot and swaps it with the shared one, so neither ever waits on the other.
+// a frame replaced before the renderer took it is dropped, a draw without a
+// new frame shows the previous one again.
+struct FrameExchange
+{
+	SimulationFrame slots[NUM_FRAME_SLOTS];
+	std::atomic<u32> shared;
+	// only touched by the simulation
+	u32 back;
+	// only touched by the renderer
+	u32 front;
+
+	// sequence of the frame the renderer took last
+	std::atomic<u64> consumed;
+
+	std::atomic<u64> published;
+	std::atomic<u64> dropped;
+	std::atomic<u64> duplicated;
+
+	// lets a reader sleep until the next publish, see waitForFrame
+	std::mutex waitLock;
+	std::condition_variable waiting;
+};
+
+// runs the board on its own thread at the scheduler's rate. generations are
+// batched per published frame by the pacer, so fast rates don't spend their
+// time copying frames nobody sees. the optional parts are NULL when unused.
+struct Simulation
+{
+	Life* life;
+	Replay* replay;
+	TiledLife* tiled;
+	// steps on the device, only from the thread that owns the gl context
+	GpuLife* gpu;
+	// the part of a tiled board to extract, written by the renderer
+	std::atomic<u64> viewX;
+	std::atomic<u64> viewY;
+	std::atomic<u32> viewLevel;
+	FrameView extracted;
+	Recorder* recorder;
+	Checkpointer* checkpointer;
+	u32 checkpointInterval;
+	u64 lastCheckpoint;
+
+	Scheduler scheduler;
+	FramePacer pacer;
+	u64 (*timer)();
+	// written by the renderer, picked up before the next generation
+	std::atomic<u32> rate;
+	std::atomic<bool> paused;
+	// a replay that ran out
+	std::atomic<bool> finished;
+	// a host board that went settleAfter generations without a birth or
+	// death is held like a finished replay, 0 never holds it. set by the
+	// simulation, cleared by the renderer to let the board go again.
+	u32 settleAfter;
+	std::atomic<bool> settled;
+	// called after each publish from the thread that published, NULL when
+	// the renderer doesn't wait on them
+	void (*wakeRenderer)();
+
+	// only touched by the simulation
+	u64 stillGenerations;
+
+	// a held simulation sleeps on this until wakeSimulation
+	std::mutex holdLock;
+	std::condition_variable resumed;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	FrameExchange frames;
+
+	// tiles changed since the last publish, and the changes of the last few
+	// publishes by sequence. only touched by the simulation.
+	std::vector<u8> dirty;
+	bool allDirty;
+	std::vector<u8> dirtyHistory[DIRTY_HISTORY_SIZE];
+	bool allDirtyHistory[DIRTY_HISTORY_SIZE];
+};
+
+// the caller fills in life and the optional parts first
+void initSimulation(Simulation* simulation, Life* life);
+void setSimulationClock(Simulation* simulation, u32 rate, u64 (*timer)(), u64 frequency);
+// sets the clock and starts the thread
+void startSimulation(Simulation* simulation, u32 rate, u64 (*timer)(), u64 frequency, u64 frameBudget);
+void stopSimulation(Simulation* simulation);
+// call after changing paused, settled or the view so a held simulation sees it
+void wakeSimulation(Simulation* simulation);
+
+// runs one generation on the caller's thread, false once a replay has run out
+bool stepSimulation(Simulation* simulation);
+// runs the generations that are due on the caller's thread, at most limit
+// and no more once budget ticks went by, 0 has no budget. the generation
+// that crosses the budget still finishes. returns how many ran.
+u32 advanceSimulation(Simulation* simulation, u32 limit, u64 budget);
+void publishFrame(Simulation* simulation);
+
+// the latest published frame, returns true if it wasn't seen before
+bool acquireFrame(Simulation* simulation, const SimulationFrame** frame);
+
+// where the next tiled frame is extracted from, see FrameView
+void setSimulationView(Simulation* simulation, u64 x, u64 y, u32 level);
+
+// true when acquireFrame would return a new frame
+inline bool frameWaiting(const Simulation* simulation)
+{
+	return (simulation->frames.shared.load(std::memory_order_relaxed) & FRAME_FRESH) != 0;
+}
+
+// sleeps until a frame is waiting or for microseconds at most, returns frameWaiting
+bool waitForFrame(Simulation* simulation, u64 microseconds);
+
+// nothing is stepped while paused, after a replay ran out or once the board settled
+inline bool simulationHeld(const Simulation* simulation)
+{
+	return simulation->paused.load(std::memory_order_relaxed) ||
+		simulation->finished.load(std::memory_order_relaxed) ||
+		simulation->settled.load(std::memory_order_relaxed);
+}
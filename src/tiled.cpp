@@ -0,0 +1,561 @@
+#include "tiled.h"
+#include "patterns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const u32 SCRATCH_ROWS = TILE_SIZE + 2;
+static const u32 SCRATCH_WORDS = TILE_ROW_WORDS + 2;
+
+static u64 alignUp(u64 value, u64 alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static u64 tileOffset(const TiledLife* tiled, u32 plane, u64 tile)
+{
+	return tiled->planeOffset + (plane * tiled->tileCount + tile) * TILE_BYTES;
+}
+
+static void evictTile(TiledLife* tiled)
+{
+	u64 key = tiled->lru.back();
+	ResidentTile& tile = tiled->resident[key];
+	if (tile.dirty)
+	{
+		flushFileRange(tile.bits, TILE_BYTES);
+		tiled->tileWritebacks++;
+	}
+	unmapFileRange(tile.bits, TILE_BYTES);
+	tiled->resident.erase(key);
+	tiled->lru.pop_back();
+	tiled->tileEvictions++;
+}
+
+static u64* acquireTile(TiledLife* tiled, u32 plane, u64 tile, bool write)
+{
+	u64 key = plane * tiled->tileCount + tile;
+	std::unordered_map<u64, ResidentTile>::iterator found = tiled->resident.find(key);
+	if (found != tiled->resident.end())
+	{
+		tiled->lru.splice(tiled->lru.begin(), tiled->lru, found->second.lru);
+		found->second.dirty |= write;
+		return found->second.bits;
+	}
+
+	while (tiled->resident.size() >= tiled->capacity)
+	{
+		evictTile(tiled);
+	}
+
+	u64* bits = (u64*)mapFileRange(&tiled->file, tileOffset(tiled, plane, tile), TILE_BYTES);
+	if (!bits)
+	{
+		printf("failed to map tile %llu\n", tile);
+		abort();
+	}
+	tiled->lru.push_front(key);
+	ResidentTile& resident = tiled->resident[key];
+	resident.bits = bits;
+	resident.dirty = write;
+	resident.lru = tiled->lru.begin();
+	tiled->tileLoads++;
+	return bits;
+}
+
+static void prefetchTile(TiledLife* tiled, u32 plane, u64 tile)
+{
+	if (tiled->occupied[plane][tile] && tiled->resident.find(plane * tiled->tileCount + tile) == tiled->resident.end())
+	{
+		prefetchFileRange(acquireTile(tiled, plane, tile, false), TILE_BYTES);
+	}
+}
+
+bool openTiledLife(TiledLife* tiled, const char* path, u32 width, u32 height, u32 capacity)
+{
+	// an existing board keeps its own size
+	MappedFile existing;
+	FILE* probe = fopen(path, "rb");
+	if (probe)
+	{
+		fclose(probe);
+		if (!mapFile(path, &existing))
+		{
+			return false;
+		}
+		TiledHeader header;
+		bool valid = existing.size >= sizeof(header);
+		if (valid)
+		{
+			memcpy(&header, existing.data, sizeof(header));
+			valid = header.magic == TILED_MAGIC && header.version == TILED_VERSION && header.tileSize == TILE_SIZE;
+		}
+		unmapFile(&existing);
+		if (!valid)
+		{
+			printf("%s is not a tiled board\n", path);
+			return false;
+		}
+		width = header.width;
+		height = header.height;
+	}
+
+	tiled->width = width;
+	tiled->height = height;
+	tiled->tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tiled->tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	tiled->tileCount = (u64)tiled->tilesX * tiled->tilesY;
+	tiled->planeOffset = alignUp(sizeof(TiledHeader) + 2 * tiled->tileCount, FILE_MAPPING_ALIGNMENT);
+	tiled->capacity = capacity < MIN_TILE_CACHE ? MIN_TILE_CACHE : capacity;
+	tiled->tileLoads = 0;
+	tiled->tileEvictions = 0;
+	tiled->tileWritebacks = 0;
+	tiled->lru.clear();
+	tiled->resident.clear();
+
+	u64 size = tiled->planeOffset + 2 * tiled->tileCount * TILE_BYTES;
+	if (!openWritableFile(path, size, &tiled->file))
+	{
+		return false;
+	}
+	u8* base = (u8*)mapFileRange(&tiled->file, 0, tiled->planeOffset);
+	if (!base)
+	{
+		printf("failed to map %s\n", path);
+		closeWritableFile(&tiled->file);
+		return false;
+	}
+
+	tiled->header = (TiledHeader*)base;
+	tiled->occupied[0] = base + sizeof(TiledHeader);
+	tiled->occupied[1] = tiled->occupied[0] + tiled->tileCount;
+	if (tiled->header->magic != TILED_MAGIC)
+	{
+		TiledHeader* header = tiled->header;
+		header->magic = TILED_MAGIC;
+		header->version = TILED_VERSION;
+		header->width = width;
+		header->height = height;
+		header->tileSize = TILE_SIZE;
+		header->current = 0;
+		header->generation = 0;
+	}
+
+	tiled->scratch.resize(SCRATCH_ROWS * SCRATCH_WORDS);
+	tiled->output.resize(TILE_SIZE * TILE_ROW_WORDS);
+	return true;
+}
+
+void closeTiledLife(TiledLife* tiled)
+{
+	while (!tiled->lru.empty())
+	{
+		evictTile(tiled);
+	}
+	flushFileRange(tiled->header, tiled->planeOffset);
+	unmapFileRange(tiled->header, tiled->planeOffset);
+	closeWritableFile(&tiled->file);
+	tiled->header = NULL;
+}
+
+static void gatherTile(TiledLife* tiled, u32 plane, u32 tx, u32 ty)
+{
+	u64* scratch = tiled->scratch.data();
+	memset(scratch, 0, tiled->scratch.size() * sizeof(u64));
+
+	// each neighbour is copied as soon as it is mapped, so mapping the next
+	// one can never evict a tile that is still being read
+	for (int dy = -1; dy <= 1; dy++)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+		{
+			i64 nx = (i64)tx + dx;
+			i64 ny = (i64)ty + dy;
+			if (nx < 0 || ny < 0 || nx >= tiled->tilesX || ny >= tiled->tilesY)
+			{
+				continue;
+			}
+			u64 tile = (u64)ny * tiled->tilesX + nx;
+			if (!tiled->occupied[plane][tile])
+			{
+				continue;
+			}
+
+			const u64* bits = acquireTile(tiled, plane, tile, false);
+			u32 firstRow = dy < 0 ? TILE_SIZE - 1 : 0;
+			u32 rows = dy == 0 ? TILE_SIZE : 1;
+			u32 firstWord = dx < 0 ? TILE_ROW_WORDS - 1 : 0;
+			u32 words = dx == 0 ? TILE_ROW_WORDS : 1;
+			u32 scratchRow = dy < 0 ? 0 : dy == 0 ? 1 : TILE_SIZE + 1;
+			u32 scratchWord = dx < 0 ? 0 : dx == 0 ? 1 : TILE_ROW_WORDS + 1;
+			for (u32 row = 0; row < rows; row++)
+			{
+				memcpy(scratch + (scratchRow + row) * SCRATCH_WORDS + scratchWord,
+					   bits + (firstRow + row) * TILE_ROW_WORDS + firstWord,
+					   words * sizeof(u64));
+			}
+		}
+	}
+}
+
+// bits of the word starting at cell first that fall in [begin, end)
+static u64 rangeMask(u64 first, u64 begin, u64 end)
+{
+	if (end <= first || begin >= first + 64 || begin >= end)
+	{
+		return 0;
+	}
+	u64 start = begin > first ? begin - first : 0;
+	u64 stop = end < first + 64 ? end - first : 64;
+	u64 high = stop == 64 ? ~0ull : (1ull << stop) - 1;
+	return high & ~((1ull << start) - 1);
+}
+
+// bit sliced neighbour count, a live cell is born or survives with 2 or 3
+static bool computeTile(TiledLife* tiled, u32 tx, u32 ty)
+{
+	const u64* scratch = tiled->scratch.data();
+	u64* output = tiled->output.data();
+
+	u64 wordMasks[TILE_ROW_WORDS];
+	for (u32 word = 0; word < TILE_ROW_WORDS; word++)
+	{
+		wordMasks[word] = rangeMask((u64)tx * TILE_SIZE + word * 64, 1, tiled->width - 1);
+	}
+
+	u64 any = 0;
+	for (u32 row = 0; row < TILE_SIZE; row++)
+	{
+		u64* out = output + row * TILE_ROW_WORDS;
+		u64 y = (u64)ty * TILE_SIZE + row;
+		if (y == 0 || y >= tiled->height - 1)
+		{
+			memset(out, 0, TILE_ROW_WORDS * sizeof(u64));
+			continue;
+		}
+
+		const u64* rows[3] =
+		{
+			scratch + row * SCRATCH_WORDS,
+			scratch + (row + 1) * SCRATCH_WORDS,
+			scratch + (row + 2) * SCRATCH_WORDS,
+		};
+		for (u32 word = 1; word <= TILE_ROW_WORDS; word++)
+		{
+			u64 s0 = 0, s1 = 0, s2 = 0;
+			for (u32 r = 0; r < 3; r++)
+			{
+				u64 centre = rows[r][word];
+				u64 neighbours[3] =
+				{
+					(centre << 1) | (rows[r][word - 1] >> 63),
+					(centre >> 1) | (rows[r][word + 1] << 63),
+					r == 1 ? 0 : centre,
+				};
+				for (u32 n = 0; n < 3; n++)
+				{
+					u64 carry0 = s0 & neighbours[n];
+					s0 ^= neighbours[n];
+					u64 carry1 = s1 & carry0;
+					s1 ^= carry0;
+					s2 |= carry1;
+				}
+			}
+			out[word - 1] = s1 & ~s2 & wordMasks[word - 1];
+			any |= out[word - 1];
+		}
+	}
+	return any != 0;
+}
+
+void stepTiledLife(TiledLife* tiled)
+{
+	std::lock_guard<std::mutex> guard(tiled->lock);
+	u32 in = tiled->header->current;
+	u32 out = 1 - in;
+
+	// sweep vertical stripes so the three input rows of a stripe plus the
+	// prefetched row after them stay resident
+	u32 stripe = tiled->capacity / 4 > 2 ? tiled->capacity / 4 - 2 : 1;
+	for (u32 stripeX = 0; stripeX < tiled->tilesX; stripeX += stripe)
+	{
+		u32 stripeEnd = stripeX + stripe < tiled->tilesX ? stripeX + stripe : tiled->tilesX;
+		for (u32 ty = 0; ty < tiled->tilesY; ty++)
+		{
+			if (ty + 2 < tiled->tilesY)
+			{
+				for (u32 tx = stripeX ? stripeX - 1 : 0; tx <= stripeEnd && tx < tiled->tilesX; tx++)
+				{
+					prefetchTile(tiled, in, (u64)(ty + 2) * tiled->tilesX + tx);
+				}
+			}
+
+			for (u32 tx = stripeX; tx < stripeEnd; tx++)
+			{
+				u64 tile = (u64)ty * tiled->tilesX + tx;
+				bool neighbourhood = false;
+				for (int dy = -1; dy <= 1 && !neighbourhood; dy++)
+				{
+					for (int dx = -1; dx <= 1 && !neighbourhood; dx++)
+					{
+						i64 nx = (i64)tx + dx;
+						i64 ny = (i64)ty + dy;
+						neighbourhood = nx >= 0 && ny >= 0 && nx < tiled->tilesX && ny < tiled->tilesY &&
+										tiled->occupied[in][ny * tiled->tilesX + nx];
+					}
+				}
+
+				// the stale contents of an unoccupied tile are never read
+				tiled->occupied[out][tile] = 0;
+				if (!neighbourhood)
+				{
+					continue;
+				}
+
+				gatherTile(tiled, in, tx, ty);
+				if (computeTile(tiled, tx, ty))
+				{
+					u64* bits = acquireTile(tiled, out, tile, true);
+					memcpy(bits, tiled->output.data(), TILE_BYTES);
+					tiled->occupied[out][tile] = 1;
+				}
+			}
+		}
+	}
+
+	tiled->header->current = out;
+	tiled->header->generation++;
+}
+
+void setTiledRun(TiledLife* tiled, u64 x, u64 y, u64 length)
+{
+	if (y >= tiled->height || x >= tiled->width)
+	{
+		return;
+	}
+	u64 end = x + length < tiled->width ? x + length : tiled->width;
+
+	std::lock_guard<std::mutex> guard(tiled->lock);
+	u32 plane = tiled->header->current;
+	while (x < end)
+	{
+		u64 tile = (y / TILE_SIZE) * tiled->tilesX + x / TILE_SIZE;
+		u64 tileStart = x - x % TILE_SIZE;
+		u64 tileEnd = tileStart + TILE_SIZE < end ? tileStart + TILE_SIZE : end;
+
+		u64* bits = acquireTile(tiled, plane, tile, true);
+		if (!tiled->occupied[plane][tile])
+		{
+			memset(bits, 0, TILE_BYTES);
+			tiled->occupied[plane][tile] = 1;
+		}
+
+		u64* row = bits + (y % TILE_SIZE) * TILE_ROW_WORDS;
+		for (u32 word = 0; word < TILE_ROW_WORDS; word++)
+		{
+			row[word] |= rangeMask(tileStart + word * 64, x, tileEnd);
+		}
+		x = tileEnd;
+	}
+}
+
+void readTiledWindow(TiledLife* tiled, u64 x, u64 y, u32 width, u32 height, u32* ages)
+{
+	std::lock_guard<std::mutex> guard(tiled->lock);
+	u32 plane = tiled->header->current;
+	memset(ages, 0, (size_t)width * height * sizeof(u32));
+
+	for (u32 row = 0; row < height; row++)
+	{
+		u64 boardY = y + row;
+		if (boardY >= tiled->height)
+		{
+			break;
+		}
+
+		u64 boardX = x;
+		u64 end = x + width < tiled->width ? x + width : tiled->width;
+		while (boardX < end)
+		{
+			u64 tile = (boardY / TILE_SIZE) * tiled->tilesX + boardX / TILE_SIZE;
+			u64 tileEnd = boardX - boardX % TILE_SIZE + TILE_SIZE;
+			tileEnd = tileEnd < end ? tileEnd : end;
+			if (tiled->occupied[plane][tile])
+			{
+				const u64* bits = acquireTile(tiled, plane, tile, false) + (boardY % TILE_SIZE) * TILE_ROW_WORDS;
+				for (u64 cell = boardX; cell < tileEnd; cell++)
+				{
+					u64 column = cell % TILE_SIZE;
+					ages[row * width + (cell - x)] = (bits[column / 64] >> (column % 64)) & 1;
+				}
+			}
+			boardX = tileEnd;
+		}
+	}
+}
+
+void readTiledBlocks(TiledLife* tiled, u64 x, u64 y, u32 level, u32 width, u32 height, u32* ages)
+{
+	if (level == 0)
+	{
+		readTiledWindow(tiled, x, y, width, height, ages);
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(tiled->lock);
+	u32 plane = tiled->header->current;
+	memset(ages, 0, (size_t)width * height * sizeof(u32));
+	if (x >= tiled->width || y >= tiled->height)
+	{
+		return;
+	}
+
+	u64 endX = x + ((u64)width << level);
+	u64 endY = y + ((u64)height << level);
+	endX = endX < tiled->width ? endX : tiled->width;
+	endY = endY < tiled->height ? endY : tiled->height;
+	u64 firstTileX = x / TILE_SIZE;
+	u64 firstTileY = y / TILE_SIZE;
+	u64 endTileX = (endX + TILE_SIZE - 1) / TILE_SIZE;
+	u64 endTileY = (endY + TILE_SIZE - 1) / TILE_SIZE;
+	bool coarse = (endTileX - firstTileX) * (endTileY - firstTileY) > tiled->capacity / 2;
+
+	for (u64 ty = firstTileY; ty < endTileY; ty++)
+	{
+		for (u64 tx = firstTileX; tx < endTileX; tx++)
+		{
+			u64 tile = ty * tiled->tilesX + tx;
+			if (!tiled->occupied[plane][tile])
+			{
+				continue;
+			}
+			// the part of the tile inside the window
+			u64 left = tx * TILE_SIZE > x ? tx * TILE_SIZE : x;
+			u64 right = (tx + 1) * TILE_SIZE < endX ? (tx + 1) * TILE_SIZE : endX;
+			u64 bottom = ty * TILE_SIZE > y ? ty * TILE_SIZE : y;
+			u64 top = (ty + 1) * TILE_SIZE < endY ? (ty + 1) * TILE_SIZE : endY;
+
+			if (coarse)
+			{
+				for (u64 row = (bottom - y) >> level; row <= (top - 1 - y) >> level; row++)
+				{
+					for (u64 column = (left - x) >> level; column <= (right - 1 - x) >> level; column++)
+					{
+						ages[row * width + column] = 1;
+					}
+				}
+				continue;
+			}
+
+			const u64* bits = acquireTile(tiled, plane, tile, false);
+			u64 tileLeft = tx * TILE_SIZE;
+			for (u64 boardY = bottom; boardY < top; boardY++)
+			{
+				const u64* row = bits + (boardY % TILE_SIZE) * TILE_ROW_WORDS;
+				u32* texels = ages + ((boardY - y) >> level) * width;
+				for (u64 word = (left - tileLeft) / 64; word <= (right - 1 - tileLeft) / 64; word++)
+				{
+					u64 first = tileLeft + word * 64;
+					u64 value = row[word] & rangeMask(first, left, right);
+					if (level >= 6)
+					{
+						// the word lies in a single block
+						texels[(first - x) >> level] |= value != 0;
+						continue;
+					}
+					while (value)
+					{
+						u64 cell = first + ctz64(value);
+						texels[(cell - x) >> level] = 1;
+						value &= value - 1;
+					}
+				}
+			}
+		}
+	}
+}
+
+u64 tiledPopulation(TiledLife* tiled)
+{
+	std::lock_guard<std::mutex> guard(tiled->lock);
+	u32 plane = tiled->header->current;
+	u64 population = 0;
+	for (u64 tile = 0; tile < tiled->tileCount; tile++)
+	{
+		if (!tiled->occupied[plane][tile])
+		{
+			continue;
+		}
+		const u64* bits = acquireTile(tiled, plane, tile, false);
+		for (u64 word = 0; word < TILE_BYTES / sizeof(u64); word++)
+		{
+			population += popCount(bits[word]);
+		}
+	}
+	return population;
+}
+
+bool tiledExtinct(const TiledLife* tiled)
+{
+	const u8* occupied = tiled->occupied[tiled->header->current];
+	for (u64 tile = 0; tile < tiled->tileCount; tile++)
+	{
+		if (occupied[tile])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+struct TiledPatternTarget
+{
+	TiledLife* tiled;
+	i64 left;
+	i64 top;
+};
+
+static void writeTiledRun(void* user, u64 x, u64 y, u64 length)
+{
+	TiledPatternTarget* target = (TiledPatternTarget*)user;
+	TiledLife* tiled = target->tiled;
+	i64 boardY = target->top - (i64)y;
+	i64 first = target->left + (i64)x;
+	i64 last = first + (i64)length;
+	first = first < 1 ? 1 : first;
+	last = last > (i64)tiled->width - 1 ? (i64)tiled->width - 1 : last;
+	if (boardY >= 1 && boardY < (i64)tiled->height - 1 && first < last)
+	{
+		setTiledRun(tiled, first, boardY, last - first);
+	}
+}
+
+bool loadTiledPattern(TiledLife* tiled, const char* path)
+{
+	Pattern pattern;
+	if (!openPattern(path, &pattern))
+	{
+		return false;
+	}
+	if (pattern.width + 2 > tiled->width || pattern.height + 2 > tiled->height)
+	{
+		printf("%s is %llu x %llu, clipping it to the board\n", path, pattern.width, pattern.height);
+	}
+
+	TiledPatternTarget target;
+	target.tiled = tiled;
+	target.left = ((i64)tiled->width - (i64)pattern.width) / 2;
+	target.top = ((i64)tiled->height + (i64)pattern.height) / 2 - 1;
+
+	i64 windowX = 1 - target.left > 0 ? 1 - target.left : 0;
+	i64 windowY = target.top - ((i64)tiled->height - 2) > 0 ? target.top - ((i64)tiled->height - 2) : 0;
+	i64 windowRight = (i64)tiled->width - 1 - target.left;
+	i64 windowBottom = target.top - 1;
+	if (windowRight > windowX && windowBottom >= windowY)
+	{
+		readPatternWindow(&pattern, windowX, windowY, windowRight - windowX, windowBottom - windowY + 1, writeTiledRun, &target);
+	}
+
+	closePattern(&pattern);
+	return true;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "common.h"
+#include "platform.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// bit packed board kept in a sparse file, for boards that don't fit in memory.
+// the file holds a header, one occupancy byte per tile and plane, and two
+// planes of TILE_SIZE x TILE_SIZE tiles that the step ping-pongs between.
+// tiles are mapped on demand into a bounded lru, empty tiles are never
+// mapped or written. rows run bottom up like Life, cell x of a row is bit
+// x % 64 of word x / 64.
+static const u32 TILE_SIZE = 1024;
+static const u32 TILE_ROW_WORDS = TILE_SIZE / 64;
+static const u64 TILE_BYTES = (u64)TILE_SIZE * TILE_SIZE / 8;
+static const u32 TILED_MAGIC = 0x5443474c; // "LGCT"
+static const u32 TILED_VERSION = 1;
+static const u32 DEFAULT_TILE_CACHE = 1024;
+static const u32 MIN_TILE_CACHE = 16;
+
+struct TiledHeader
+{
+	u32 magic;
+	u32 version;
+	u32 width;
+	u32 height;
+	u32 tileSize;
+	u32 current;
+	u64 generation;
+};
+
+struct ResidentTile
+{
+	u64* bits;
+	bool dirty;
+	std::list<u64>::iterator lru;
+};
+
+struct TiledLife
+{
+	WritableFile file;
+	TiledHeader* header;
+	u32 width;
+	u32 height;
+	u32 tilesX;
+	u32 tilesY;
+	u64 tileCount;
+	u64 planeOffset;
+	// mapped from the file, one byte per tile of each plane
+	u8* occupied[2];
+
+	// most recently used at the front, keyed by plane * tileCount + tile
+	std::list<u64> lru;
+	std::unordered_map<u64, ResidentTile> resident;
+	u32 capacity;
+	// only needed by writers that run next to each other, the step is single threaded
+	std::mutex lock;
+
+	std::vector<u64> scratch;
+	std::vector<u64> output;
+
+	u64 tileLoads;
+	u64 tileEvictions;
+	u64 tileWritebacks;
+};
+
+// opens an existing board or creates an empty width x height one
+bool openTiledLife(TiledLife* tiled, const char* path, u32 width, u32 height, u32 capacity);
+void closeTiledLife(TiledLife* tiled);
+
+void stepTiledLife(TiledLife* tiled);
+// sets a run of cells alive, safe to call from several threads at once
+void setTiledRun(TiledLife* tiled, u64 x, u64 y, u64 length);
+// copies a window of the board into ages, 1 for live cells
+void readTiledWindow(TiledLife* tiled, u64 x, u64 y, u32 width, u32 height, u32* ages);
+// like readTiledWindow with every texel covering 2^level x 2^level cells from
+// x and y, which are multiples of that. a texel is 1 when a cell in it is alive.
+// only occupied tiles in the window are read, and once the window spans more
+// tiles than half the cache only the occupancy map is, every texel a live
+// tile overlaps is set then.
+void readTiledBlocks(TiledLife* tiled, u64 x, u64 y, u32 level, u32 width, u32 height, u32* ages);
+bool loadTiledPattern(TiledLife* tiled, const char* path);
+// live cells on the whole board, maps every occupied tile
+u64 tiledPopulation(TiledLife* tiled);
+// only reads the occupancy map, a stepped tile is occupied when a cell in it is alive
+bool tiledExtinct(const TiledLife* tiled);
+
+inline u64 tiledGeneration(const TiledLife* tiled)
+{
+	return tiled->header->generation;
+}
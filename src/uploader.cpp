@@ -0,0 +1,741 @@
+#include "uploader.h"
+#include "life.h"
+#include <glfw/glfw3.h>
+#include <math.h>
+#include <string.h>
+
+static bool bufferStorageSupported()
+{
+	return glBufferStorage && (hasGLVersion(4, 4) || hasGLExtension("GL_ARB_buffer_storage"));
+}
+
+// bytes from the start of a row to the given cell, rounded up to whole texels
+static u32 cellOffset(const Uploader* uploader, u32 cell)
+{
+	switch (uploader->format)
+	{
+		case UPLOAD_AGES:
+		{
+			return cell * sizeof(u32);
+		} break;
+		case UPLOAD_BANDS:
+		{
+			return cell;
+		} break;
+		case UPLOAD_BITS:
+		{
+			return (cell + 31) / 32 * sizeof(u32);
+		} break;
+	}
+	return 0;
+}
+
+// fills encoded for part of a row, bits are written in whole words
+static void encodeCells(Uploader* uploader, const u32* ages, u32 row, u32 firstCell, u32 endCell)
+{
+	const u32* cells = ages + (size_t)row * uploader->width;
+	u8* encoded = uploader->encoded.data() + (size_t)row * uploader->rowBytes;
+	switch (uploader->format)
+	{
+		case UPLOAD_AGES:
+		{
+		} break;
+		case UPLOAD_BANDS:
+		{
+			for (u32 x = firstCell; x < endCell; x++)
+			{
+				encoded[x] = (u8)ageBand(cells[x]);
+			}
+		} break;
+		case UPLOAD_BITS:
+		{
+			u32* words = (u32*)encoded;
+			for (u32 word = firstCell / 32; word * 32 < endCell; word++)
+			{
+				u32 end = word * 32 + 32 < uploader->width ? word * 32 + 32 : uploader->width;
+				u32 bits = 0;
+				for (u32 x = word * 32; x < end; x++)
+				{
+					bits |= (u32)(cells[x] != 0) << (x & 31);
+				}
+				words[word] = bits;
+			}
+		} break;
+	}
+}
+
+// the encoded frame, or the ages themselves when they're uploaded as they are
+static const u8* encodeFrame(Uploader* uploader, const u32* ages)
+{
+	if (uploader->format == UPLOAD_AGES)
+	{
+		return (const u8*)ages;
+	}
+	for (u32 y = 0; y < uploader->height; y++)
+	{
+		encodeCells(uploader, ages, y, 0, uploader->width);
+	}
+	return uploader->encoded.data();
+}
+
+void initUploader(Uploader* uploader, u32 width, u32 height, UploadFormat format, const u32* initial, bool threaded)
+{
+	uploader->width = width;
+	uploader->height = height;
+	uploader->format = format;
+	uploader->rowBytes = cellOffset(uploader, width);
+	uploader->size = uploader->rowBytes * height;
+	uploader->persistent = bufferStorageSupported();
+	uploader->regionCount = uploader->persistent || threaded ? UPLOAD_RING_SIZE : 1;
+	uploader->drawn = 0;
+	uploader->threaded = false;
+	uploader->skipped = 0;
+	uploader->tileColumns = (width + DIRTY_TILE_WIDTH - 1) / DIRTY_TILE_WIDTH;
+	uploader->tileRows = (height + DIRTY_TILE_HEIGHT - 1) / DIRTY_TILE_HEIGHT;
+	uploader->encoded.assign(format == UPLOAD_AGES ? 0 : uploader->size, 0);
+	uploader->stalls = 0;
+	uploader->uploadedBytes = 0;
+	uploader->fullUploads = 0;
+	uploader->partialUploads = 0;
+	uploader->sparseUploads = 0;
+	uploader->crowded = true;
+	uploader->heat.assign(2 * uploader->tileColumns * uploader->tileRows, 0);
+	uploader->heatClock = 0;
+	uploader->pendingDamage.assign(uploader->tileColumns * uploader->tileRows, 0);
+	uploader->allPendingDamaged = false;
+	uploader->damage.assign(uploader->tileColumns * uploader->tileRows, 0);
+	uploader->allDamaged = true;
+
+	u32 size = uploader->size;
+	const u8* first = encodeFrame(uploader, initial);
+	glGenBuffers(uploader->regionCount, uploader->buffers);
+	glGenTextures(uploader->regionCount, uploader->textures);
+	glGenBuffers(uploader->regionCount, uploader->instanceBuffers);
+	for (u32 i = 0; i < uploader->regionCount; i++)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, uploader->buffers[i]);
+		if (uploader->persistent)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_TEXTURE_BUFFER, size, first, flags);
+			uploader->mapped[i] = glMapBufferRange(GL_TEXTURE_BUFFER, 0, size, flags);
+		}
+		else
+		{
+			glBufferData(GL_TEXTURE_BUFFER, size, first, GL_STREAM_DRAW);
+			uploader->mapped[i] = NULL;
+		}
+		uploader->fences[i] = NULL;
+		uploader->readyFences[i] = NULL;
+		uploader->views[i].x = 0;
+		uploader->views[i].y = 0;
+		uploader->views[i].level = 0;
+		uploader->stale[i].assign(uploader->tileColumns * uploader->tileRows, 0);
+		uploader->allStale[i] = false;
+		uploader->sparse[i] = false;
+		uploader->instanceCounts[i] = 0;
+		uploader->instanceCapacities[i] = 0;
+		uploader->heatClocks[i] = 0;
+
+		glBindTexture(GL_TEXTURE_BUFFER, uploader->textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, uploadFormatTexels(format), uploader->buffers[i]);
+	}
+
+	// levels wider than a texture can be are drawn from the cells instead
+	DensityPyramid* pyramid = &uploader->pyramid;
+	initPyramid(pyramid, width, height, initial);
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (u32 i = 0; i < uploader->regionCount; i++)
+	{
+		for (u32 level = 0; level < MAX_PYRAMID_LEVELS; level++)
+		{
+			const PyramidLevel* pooled = &pyramid->levels[level];
+			u32* texture = &uploader->levelTextures[i][level];
+			*texture = 0;
+			if (level >= pyramid->levelCount || pooled->width > (u32)maxTextureSize || pooled->height > (u32)maxTextureSize)
+			{
+				continue;
+			}
+			glGenTextures(1, texture);
+			glBindTexture(GL_TEXTURE_2D, *texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, pooled->width, pooled->height, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, pooled->bands.data());
+		}
+
+		u32* heatTexture = &uploader->heatTextures[i];
+		*heatTexture = 0;
+		if (uploader->tileColumns > (u32)maxTextureSize || uploader->tileRows > (u32)maxTextureSize)
+		{
+			continue;
+		}
+		glGenTextures(1, heatTexture);
+		glBindTexture(GL_TEXTURE_2D, *heatTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32UI, uploader->tileColumns, uploader->tileRows, 0, GL_RG_INTEGER, GL_UNSIGNED_INT, uploader->heat.data());
+	}
+}
+
+void destroyUploader(Uploader* uploader)
+{
+	for (u32 i = 0; i < uploader->regionCount; i++)
+	{
+		if (uploader->fences[i])
+		{
+			glDeleteSync(uploader->fences[i]);
+		}
+		if (uploader->readyFences[i])
+		{
+			glDeleteSync(uploader->readyFences[i]);
+		}
+		if (uploader->mapped[i])
+		{
+			glBindBuffer(GL_TEXTURE_BUFFER, uploader->buffers[i]);
+			glUnmapBuffer(GL_TEXTURE_BUFFER);
+		}
+	}
+	glDeleteTextures(uploader->regionCount, uploader->textures);
+	for (u32 i = 0; i < uploader->regionCount; i++)
+	{
+		for (u32 level = 0; level < uploader->pyramid.levelCount; level++)
+		{
+			if (uploader->levelTextures[i][level])
+			{
+				glDeleteTextures(1, &uploader->levelTextures[i][level]);
+			}
+		}
+		if (uploader->heatTextures[i])
+		{
+			glDeleteTextures(1, &uploader->heatTextures[i]);
+		}
+	}
+	glDeleteBuffers(uploader->regionCount, uploader->buffers);
+	glDeleteBuffers(uploader->regionCount, uploader->instanceBuffers);
+}
+
+static void waitForRegion(Uploader* uploader, u32 region)
+{
+	GLsync fence = uploader->fences[region];
+	if (!fence)
+	{
+		return;
+	}
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		uploader->stalls++;
+		while (status == GL_TIMEOUT_EXPIRED)
+		{
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, UPLOAD_WAIT_NANOSECONDS);
+		}
+	}
+	glDeleteSync(fence);
+	uploader->fences[region] = NULL;
+}
+
+static void addRange(Uploader* uploader, u32 row, u32 firstCell, u32 endCell)
+{
+	std::vector<UploadRange>& ranges = uploader->ranges;
+	bool wholeRow = firstCell == 0 && endCell == uploader->width;
+	if (wholeRow && !ranges.empty())
+	{
+		UploadRange& last = ranges.back();
+		if (last.firstCell == 0 && last.endCell == uploader->width && last.row + last.rows == row)
+		{
+			last.rows++;
+			return;
+		}
+	}
+	UploadRange range = {row, 1, firstCell, endCell};
+	ranges.push_back(range);
+}
+
+// turns the stale tiles into ranges of cells. whole rows run together into
+// one range, otherwise every cell row of a run of tiles is a range of its own.
+// returns false when copying everything is cheaper.
+static bool coalesceTiles(Uploader* uploader, const std::vector<u8>& stale)
+{
+	u32 staleCount = 0;
+	for (size_t i = 0; i < stale.size(); i++)
+	{
+		staleCount += stale[i] != 0;
+	}
+	if (staleCount * UPLOAD_FULL_FRACTION > stale.size())
+	{
+		return false;
+	}
+
+	uploader->ranges.clear();
+	u32 width = uploader->width;
+	for (u32 tileRow = 0; tileRow < uploader->tileRows; tileRow++)
+	{
+		const u8* tiles = stale.data() + tileRow * uploader->tileColumns;
+		u32 firstRow = tileRow * DIRTY_TILE_HEIGHT;
+		u32 endRow = firstRow + DIRTY_TILE_HEIGHT < uploader->height ? firstRow + DIRTY_TILE_HEIGHT : uploader->height;
+
+		u32 column = 0;
+		while (column < uploader->tileColumns)
+		{
+			if (!tiles[column])
+			{
+				column++;
+				continue;
+			}
+			u32 runEnd = column + 1;
+			for (u32 next = runEnd; next < uploader->tileColumns && next <= runEnd + UPLOAD_MERGE_GAP; next++)
+			{
+				if (tiles[next])
+				{
+					runEnd = next + 1;
+				}
+			}
+
+			u32 firstCell = column * DIRTY_TILE_WIDTH;
+			u32 endCell = runEnd * DIRTY_TILE_WIDTH < width ? runEnd * DIRTY_TILE_WIDTH : width;
+			for (u32 row = firstRow; row < endRow; row++)
+			{
+				addRange(uploader, row, firstCell, endCell);
+			}
+			column = runEnd;
+		}
+	}
+	return true;
+}
+
+static void rangeBytes(const Uploader* uploader, const UploadRange* range, u32* offset, u32* size)
+{
+	u32 first = cellOffset(uploader, range->firstCell);
+	*offset = range->row * uploader->rowBytes + first;
+	*size = (range->rows - 1) * uploader->rowBytes + cellOffset(uploader, range->endCell) - first;
+}
+
+// copies the pyramid blocks over the stale tiles into the region's level textures
+static void writePyramid(Uploader* uploader, u32 region, const u8* stale, bool all)
+{
+	DensityPyramid* pyramid = &uploader->pyramid;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (u32 i = 0; i < pyramid->levelCount; i++)
+	{
+		const PyramidLevel* level = &pyramid->levels[i];
+		if (!uploader->levelTextures[region][i])
+		{
+			continue;
+		}
+		glBindTexture(GL_TEXTURE_2D, uploader->levelTextures[region][i]);
+		if (all)
+		{
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, level->width, level->height, GL_RED_INTEGER, GL_UNSIGNED_BYTE, level->bands.data());
+			uploader->uploadedBytes += level->bands.size();
+			continue;
+		}
+
+		// a rectangle for each run of tiles in a tile row
+		pyramidLevelTiles(pyramid, i, stale, &uploader->levelTiles);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, level->width);
+		for (u32 tileY = 0; tileY < level->tileRows; tileY++)
+		{
+			const u8* tiles = uploader->levelTiles.data() + (size_t)tileY * level->tileColumns;
+			u32 tileX = 0;
+			while (tileX < level->tileColumns)
+			{
+				if (!tiles[tileX])
+				{
+					tileX++;
+					continue;
+				}
+				u32 runEnd = tileX + 1;
+				while (runEnd < level->tileColumns && tiles[runEnd])
+				{
+					runEnd++;
+				}
+				u32 x = tileX * DIRTY_TILE_WIDTH;
+				u32 y = tileY * DIRTY_TILE_HEIGHT;
+				u32 endX = runEnd * DIRTY_TILE_WIDTH < level->width ? runEnd * DIRTY_TILE_WIDTH : level->width;
+				u32 endY = y + DIRTY_TILE_HEIGHT < level->height ? y + DIRTY_TILE_HEIGHT : level->height;
+				glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, endX - x, endY - y, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+								level->bands.data() + (size_t)y * level->width + x);
+				uploader->uploadedBytes += (u64)(endX - x) * (endY - y);
+				tileX = runEnd;
+			}
+		}
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	}
+}
+
+// lists the live cells into instances, false once there are too many of them.
+// a live cell's tile was active in the step that made it, so only the frame's
+// dirty tiles have to be looked at.
+static bool collectLiveCells(Uploader* uploader, const SimulationFrame* frame)
+{
+	u64 cells = (u64)uploader->width * uploader->height;
+	u64 limit = cells / UPLOAD_SPARSE_FRACTION * (uploader->crowded ? 1 : 2);
+	if (uploader->height > UPLOAD_ROW_MASK)
+	{
+		return false;
+	}
+
+	std::vector<u32>& instances = uploader->instances;
+	instances.assign(2, 0);
+	const u32* ages = frame->ages.data();
+	for (u32 tileY = 0; tileY < uploader->tileRows; tileY++)
+	{
+		u32 firstRow = tileY * DIRTY_TILE_HEIGHT;
+		u32 endRow = firstRow + DIRTY_TILE_HEIGHT < uploader->height ? firstRow + DIRTY_TILE_HEIGHT : uploader->height;
+		for (u32 tileX = 0; tileX < uploader->tileColumns; tileX++)
+		{
+			if (!frame->allDirty && !frame->dirty[tileY * uploader->tileColumns + tileX])
+			{
+				continue;
+			}
+			u32 firstCell = tileX * DIRTY_TILE_WIDTH;
+			u32 endCell = firstCell + DIRTY_TILE_WIDTH < uploader->width ? firstCell + DIRTY_TILE_WIDTH : uploader->width;
+			for (u32 y = firstRow; y < endRow; y++)
+			{
+				const u32* row = ages + (size_t)y * uploader->width;
+				for (u32 x = firstCell; x < endCell; x++)
+				{
+					if (!row[x])
+					{
+						continue;
+					}
+					if (instances.size() / 2 > limit)
+					{
+						return false;
+					}
+					instances.push_back(x);
+					instances.push_back(y | ageBand(row[x]) << UPLOAD_BAND_SHIFT);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// the buffer is orphaned like a full frame, it only grows
+static void writeInstances(Uploader* uploader, u32 region)
+{
+	u32 count = (u32)(uploader->instances.size() / 2);
+	u32 bytes = count * 2 * sizeof(u32);
+	u32* capacity = &uploader->instanceCapacities[region];
+	while (*capacity < bytes)
+	{
+		*capacity = *capacity ? *capacity * 2 : 4096;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, uploader->instanceBuffers[region]);
+	glBufferData(GL_ARRAY_BUFFER, *capacity, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, uploader->instances.data());
+	uploader->instanceCounts[region] = count;
+	uploader->uploadedBytes += bytes;
+}
+
+// adds a frame's births and deaths to the heat of their tiles
+static void updateHeat(Uploader* uploader, const SimulationFrame* frame)
+{
+	u32 now = ++uploader->heatClock;
+	if (frame->allDirty)
+	{
+		// says nothing about where the board changed
+		return;
+	}
+	u32 tileCount = uploader->tileColumns * uploader->tileRows;
+	for (u32 tile = 0; tile < tileCount; tile++)
+	{
+		if (!(frame->dirty[tile] & TILE_CHANGED))
+		{
+			continue;
+		}
+		u32* entry = &uploader->heat[2 * tile];
+		float value;
+		memcpy(&value, &entry[0], sizeof(value));
+		value = value * exp2f(-(float)(now - entry[1]) / HEAT_HALF_LIFE) + 1.0f;
+		memcpy(&entry[0], &value, sizeof(value));
+		entry[1] = now;
+	}
+}
+
+// copies the heat of the tiles that changed since the region was last written
+static void writeHeat(Uploader* uploader, u32 region, const u8* stale)
+{
+	if (!uploader->heatTextures[region])
+	{
+		return;
+	}
+	glBindTexture(GL_TEXTURE_2D, uploader->heatTextures[region]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, uploader->tileColumns);
+	for (u32 tileY = 0; tileY < uploader->tileRows; tileY++)
+	{
+		const u8* tiles = stale + (size_t)tileY * uploader->tileColumns;
+		u32 tileX = 0;
+		while (tileX < uploader->tileColumns)
+		{
+			if (!(tiles[tileX] & TILE_CHANGED))
+			{
+				tileX++;
+				continue;
+			}
+			u32 runEnd = tileX + 1;
+			while (runEnd < uploader->tileColumns && (tiles[runEnd] & TILE_CHANGED))
+			{
+				runEnd++;
+			}
+			glTexSubImage2D(GL_TEXTURE_2D, 0, tileX, tileY, runEnd - tileX, 1, GL_RG_INTEGER, GL_UNSIGNED_INT,
+							uploader->heat.data() + 2 * ((size_t)tileY * uploader->tileColumns + tileX));
+			uploader->uploadedBytes += (runEnd - tileX) * 2 * sizeof(u32);
+			tileX = runEnd;
+		}
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+// brings a region up to date with the frame
+static void writeRegion(Uploader* uploader, u32 region, const SimulationFrame* frame)
+{
+	const u32* ages = frame->ages.data();
+	const u8* dirty = frame->dirty.data();
+	bool allDirty = frame->allDirty;
+	uploader->views[region] = frame->view;
+	updatePyramid(&uploader->pyramid, ages, dirty, allDirty);
+	updateHeat(uploader, frame);
+	uploader->heatClocks[region] = uploader->heatClock;
+	// kept up for regions that are copied whole anyway, the heat goes by them
+	u32 tileCount = uploader->tileColumns * uploader->tileRows;
+	for (u32 i = 0; i < uploader->regionCount; i++)
+	{
+		std::vector<u8>& stale = uploader->stale[i];
+		uploader->allStale[i] = uploader->allStale[i] || allDirty;
+		for (u32 tile = 0; tile < tileCount && !allDirty; tile++)
+		{
+			stale[tile] |= dirty[tile];
+		}
+	}
+
+	std::vector<u8>& stale = uploader->stale[region];
+	uploader->crowded = !collectLiveCells(uploader, frame);
+	uploader->sparse[region] = !uploader->crowded;
+	if (!uploader->crowded)
+	{
+		// the board in the region falls behind, it's copied whole once the cells are drawn from it again
+		uploader->sparseUploads++;
+		uploader->allStale[region] = true;
+		writeInstances(uploader, region);
+		writeHeat(uploader, region, stale.data());
+		memset(stale.data(), 0, stale.size());
+		return;
+	}
+
+	bool partial = !uploader->allStale[region] && coalesceTiles(uploader, stale);
+	uploader->allStale[region] = false;
+	if (partial)
+	{
+		uploader->partialUploads++;
+		if (uploader->ranges.empty())
+		{
+			// nothing changed, the region already holds this frame
+			return;
+		}
+	}
+	else
+	{
+		uploader->fullUploads++;
+	}
+
+	waitForRegion(uploader, region);
+	writePyramid(uploader, region, stale.data(), !partial);
+	writeHeat(uploader, region, stale.data());
+	memset(stale.data(), 0, stale.size());
+
+	const u8* source = (const u8*)ages;
+	if (!partial)
+	{
+		source = encodeFrame(uploader, ages);
+	}
+	else if (uploader->format != UPLOAD_AGES)
+	{
+		for (size_t i = 0; i < uploader->ranges.size(); i++)
+		{
+			const UploadRange& range = uploader->ranges[i];
+			for (u32 row = range.row; row < range.row + range.rows; row++)
+			{
+				encodeCells(uploader, ages, row, range.firstCell, range.endCell);
+			}
+		}
+		source = uploader->encoded.data();
+	}
+
+	if (!uploader->persistent)
+	{
+		glBindBuffer(GL_TEXTURE_BUFFER, uploader->buffers[region]);
+		if (!partial)
+		{
+			// orphan the storage the gpu may still be drawing, the driver hands out fresh memory
+			glBufferData(GL_TEXTURE_BUFFER, uploader->size, source, GL_STREAM_DRAW);
+			uploader->uploadedBytes += uploader->size;
+			return;
+		}
+		for (size_t i = 0; i < uploader->ranges.size(); i++)
+		{
+			u32 offset;
+			u32 size;
+			rangeBytes(uploader, &uploader->ranges[i], &offset, &size);
+			glBufferSubData(GL_TEXTURE_BUFFER, offset, size, source + offset);
+			uploader->uploadedBytes += size;
+		}
+		return;
+	}
+
+	u8* mapped = (u8*)uploader->mapped[region];
+	if (!partial)
+	{
+		memcpy(mapped, source, uploader->size);
+		uploader->uploadedBytes += uploader->size;
+	}
+	else
+	{
+		for (size_t i = 0; i < uploader->ranges.size(); i++)
+		{
+			u32 offset;
+			u32 size;
+			rangeBytes(uploader, &uploader->ranges[i], &offset, &size);
+			memcpy(mapped + offset, source + offset, size);
+			uploader->uploadedBytes += size;
+		}
+	}
+}
+
+static void addDamage(std::vector<u8>* damage, bool* allDamaged, const u8* tiles, bool allTiles)
+{
+	*allDamaged = *allDamaged || allTiles;
+	for (size_t i = 0; i < damage->size() && !*allDamaged; i++)
+	{
+		(*damage)[i] |= tiles[i];
+	}
+}
+
+void uploadFrame(Uploader* uploader, const SimulationFrame* frame)
+{
+	u32 region = (uploader->drawn + 1) % uploader->regionCount;
+	writeRegion(uploader, region, frame);
+	uploader->drawn = region;
+	addDamage(&uploader->damage, &uploader->allDamaged, frame->dirty.data(), frame->allDirty);
+}
+
+static void uploadThread(Uploader* uploader)
+{
+	glfwMakeContextCurrent(uploader->context);
+	Simulation* simulation = uploader->simulation;
+	while (uploader->running.load(std::memory_order_relaxed))
+	{
+		if (!waitForFrame(simulation, UPLOAD_IDLE_MICROSECONDS))
+		{
+			continue;
+		}
+		const SimulationFrame* frame = NULL;
+		acquireFrame(simulation, &frame);
+		u32 region = uploader->writing;
+		writeRegion(uploader, region, frame);
+
+		// the renderer's context waits on this before it draws the region
+		GLsync* ready = &uploader->readyFences[region];
+		if (*ready)
+		{
+			glDeleteSync(*ready);
+		}
+		*ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+
+		u32 previous = 0;
+		{
+			std::lock_guard<std::mutex> guard(uploader->damageLock);
+			addDamage(&uploader->pendingDamage, &uploader->allPendingDamaged, frame->dirty.data(), frame->allDirty);
+			previous = uploader->shared.exchange(region | UPLOAD_FRESH, std::memory_order_acq_rel);
+		}
+		uploader->writing = previous & UPLOAD_REGION_MASK;
+		if (previous & UPLOAD_FRESH)
+		{
+			uploader->skipped++;
+		}
+		// a renderer with nothing to draw waits for events
+		glfwPostEmptyEvent();
+	}
+	glfwMakeContextCurrent(NULL);
+}
+
+void startUploadThread(Uploader* uploader, Simulation* simulation, GLFWwindow* context)
+{
+	// the region ring becomes a triple buffer, each side owns one and swaps it with the shared one
+	uploader->threaded = true;
+	uploader->simulation = simulation;
+	uploader->context = context;
+	uploader->drawn = 0;
+	uploader->shared = 1;
+	uploader->writing = 2;
+	uploader->running = true;
+	// the draws so far have to be submitted before the other context waits on their fences
+	glFlush();
+	uploader->thread = std::thread(uploadThread, uploader);
+}
+
+void stopUploadThread(Uploader* uploader)
+{
+	if (!uploader->threaded)
+	{
+		return;
+	}
+	uploader->running = false;
+	uploader->thread.join();
+}
+
+bool takeUpload(Uploader* uploader)
+{
+	if (!(uploader->shared.load(std::memory_order_relaxed) & UPLOAD_FRESH))
+	{
+		return false;
+	}
+	u32 previous = 0;
+	{
+		std::lock_guard<std::mutex> guard(uploader->damageLock);
+		previous = uploader->shared.exchange(uploader->drawn, std::memory_order_acq_rel);
+		addDamage(&uploader->damage, &uploader->allDamaged, uploader->pendingDamage.data(), uploader->allPendingDamaged);
+		memset(uploader->pendingDamage.data(), 0, uploader->pendingDamage.size());
+		uploader->allPendingDamaged = false;
+	}
+	uploader->drawn = previous & UPLOAD_REGION_MASK;
+	GLsync* ready = &uploader->readyFences[uploader->drawn];
+	glWaitSync(*ready, 0, GL_TIMEOUT_IGNORED);
+	glDeleteSync(*ready);
+	*ready = NULL;
+	return true;
+}
+
+void fenceUpload(Uploader* uploader)
+{
+	if (uploader->regionCount == 1)
+	{
+		return;
+	}
+	GLsync* fence = &uploader->fences[uploader->drawn];
+	if (*fence)
+	{
+		glDeleteSync(*fence);
+	}
+	*fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (uploader->threaded)
+	{
+		// the upload thread can only flush its own context before waiting
+		glFlush();
+	}
+}
+
+bool takeDamage(Uploader* uploader, std::vector<u8>* tiles)
+{
+	tiles->swap(uploader->damage);
+	uploader->damage.assign(tiles->size(), 0);
+	bool all = uploader->allDamaged;
+	uploader->allDamaged = false;
+	return all;
+}
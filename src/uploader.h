@@ -0,0 +1,210 @@
+#pragma once
+
+#include "common.h"
+#include "glext.h"
+#include "options.h"
+#include "pyramid.h"
+#include "simulation.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct GLFWwindow;
+
+// streams frames to the texture buffer the renderer draws from. with
+// ARB_buffer_storage every region of the ring is mapped once, persistent and
+// coherent, and frames are written straight into it. a fence after the draw
+// that reads a region keeps it from being rewritten until the gpu is done.
+// without the extension a single buffer is updated with glBufferSubData.
+//
+// each region remembers the tiles that changed since it was last written and
+// only those are copied, coalesced into as few ranges as possible. past
+// UPLOAD_FULL_FRACTION of the tiles the whole frame is copied instead.
+//
+// frames are encoded to the UploadFormat on the way, see uploadFormatTexels.
+// nearly empty boards skip all that and upload their live cells instead.
+//
+// the uploads can also run on their own thread with a context shared with
+// the renderer. the ring is then a triple buffer like the FrameExchange, the
+// thread writes one region while the renderer draws another, and a fence
+// after each write tells the renderer's context when the region is ready.
+static const u32 UPLOAD_RING_SIZE = 3;
+static const u32 UPLOAD_FULL_FRACTION = 2;
+// runs of dirty tiles in a row at most this many tiles apart are copied as one
+static const u32 UPLOAD_MERGE_GAP = 1;
+// a wait on a region that's still being drawn is retried in slices of this
+static const u64 UPLOAD_WAIT_NANOSECONDS = 1000000;
+// longest the upload thread sleeps waiting for a frame, publishes wake it
+// sooner. only bounds how long stopping it takes.
+static const u64 UPLOAD_IDLE_MICROSECONDS = 50000;
+static const u32 UPLOAD_REGION_MASK = 0x3;
+// set on the shared region when it was written since the renderer last took one
+static const u32 UPLOAD_FRESH = 0x4;
+// boards with at most one live cell in this many are uploaded as a list of the
+// live cells instead, drawn as instanced quads. once sparse a board stays so
+// until it's twice as crowded, so it doesn't flip back and forth at the edge.
+static const u32 UPLOAD_SPARSE_FRACTION = 64;
+// a listed cell is its x and y, with the colour band in the top bits of y
+static const u32 UPLOAD_BAND_SHIFT = 29;
+static const u32 UPLOAD_ROW_MASK = (1u << UPLOAD_BAND_SHIFT) - 1;
+// tiles where cells were born or died glow for the heatmap, halving every
+// this many frames written
+static const u32 HEAT_HALF_LIFE = 30;
+
+// rows of cells to copy, more than one only when they span the whole width
+struct UploadRange
+{
+	u32 row;
+	u32 rows;
+	u32 firstCell;
+	u32 endCell;
+};
+
+struct Uploader
+{
+	u32 width;
+	u32 height;
+	UploadFormat format;
+	u32 rowBytes;
+	u32 size;
+	bool persistent;
+	u32 regionCount;
+	u32 buffers[UPLOAD_RING_SIZE];
+	u32 textures[UPLOAD_RING_SIZE];
+	void* mapped[UPLOAD_RING_SIZE];
+	// after the last draw of each region, and after the upload thread's last write
+	GLsync fences[UPLOAD_RING_SIZE];
+	GLsync readyFences[UPLOAD_RING_SIZE];
+	// where each region's frame sits on the board
+	FrameView views[UPLOAD_RING_SIZE];
+	u32 drawn;
+
+	bool threaded;
+	Simulation* simulation;
+	GLFWwindow* context;
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<u32> shared;
+	// only touched by the upload thread
+	u32 writing;
+
+	// dirty tiles, see Life, that each region hasn't been given yet
+	u32 tileColumns;
+	u32 tileRows;
+	std::vector<u8> stale[UPLOAD_RING_SIZE];
+	bool allStale[UPLOAD_RING_SIZE];
+	std::vector<UploadRange> ranges;
+	// the frame in the upload format, unused for ages
+	std::vector<u8> encoded;
+
+	// the pyramid of the latest frame, and a 2d texture for each level of each region
+	DensityPyramid pyramid;
+	u32 levelTextures[UPLOAD_RING_SIZE][MAX_PYRAMID_LEVELS];
+	std::vector<u8> levelTiles;
+
+	// the live cells of each sparse region, the first instance is the board behind them
+	bool sparse[UPLOAD_RING_SIZE];
+	u32 instanceBuffers[UPLOAD_RING_SIZE];
+	u32 instanceCounts[UPLOAD_RING_SIZE];
+	u32 instanceCapacities[UPLOAD_RING_SIZE];
+	std::vector<u32> instances;
+	bool crowded;
+
+	// two u32 a tile, the heat as float bits when the tile last changed and
+	// the heat clock then. the shader decays it to the drawn region's clock,
+	// so only tiles that change are ever touched. a 2d texture a region.
+	std::vector<u32> heat;
+	u32 heatClock;
+	u32 heatClocks[UPLOAD_RING_SIZE];
+	u32 heatTextures[UPLOAD_RING_SIZE];
+
+	// tiles that changed since the renderer last asked, so it can redraw only
+	// those. the thread adds a region's tiles to pendingDamage as it publishes
+	// it, and takeUpload moves them over with the region under the same lock,
+	// so the renderer never gets a region without its tiles.
+	std::mutex damageLock;
+	std::vector<u8> pendingDamage;
+	bool allPendingDamaged;
+	std::vector<u8> damage;
+	bool allDamaged;
+
+	// uploads that had to wait on the gpu
+	u64 stalls;
+	u64 uploadedBytes;
+	u64 fullUploads;
+	u64 partialUploads;
+	u64 sparseUploads;
+	// regions written on the thread that were replaced before being drawn
+	u64 skipped;
+};
+
+// width x height boards, initial is the first frame. threaded keeps a full
+// ring even without ARB_buffer_storage, for startUploadThread.
+void initUploader(Uploader* uploader, u32 width, u32 height, UploadFormat format, const u32* initial, bool threaded);
+void destroyUploader(Uploader* uploader);
+
+// copies the tiles that changed into the next region, which gets drawn from now on
+void uploadFrame(Uploader* uploader, const SimulationFrame* frame);
+// takes frames from the simulation on a thread made current on context, which
+// has to share objects with the renderer's. uploadFrame isn't used after this.
+void startUploadThread(Uploader* uploader, Simulation* simulation, GLFWwindow* context);
+void stopUploadThread(Uploader* uploader);
+// switches to the latest region the thread wrote, true if there was a new one
+bool takeUpload(Uploader* uploader);
+// call after the draw that read uploadTexture
+void fenceUpload(Uploader* uploader);
+// swaps the tiles that changed in the frames taken since the last call into
+// tiles, true when every tile did. it starts out true.
+bool takeDamage(Uploader* uploader, std::vector<u8>* tiles);
+
+inline u32 uploadTexture(const Uploader* uploader)
+{
+	return uploader->textures[uploader->drawn];
+}
+
+inline FrameView uploadView(const Uploader* uploader)
+{
+	return uploader->views[uploader->drawn];
+}
+
+// the drawn region's texture for a pyramid level, 0 when the level has none
+inline u32 pyramidTexture(const Uploader* uploader, u32 level)
+{
+	return level < uploader->pyramid.levelCount ? uploader->levelTextures[uploader->drawn][level] : 0;
+}
+
+// true when the drawn region holds a list of live cells rather than the board
+inline bool uploadSparse(const Uploader* uploader)
+{
+	return uploader->sparse[uploader->drawn];
+}
+
+// RG32UI, a texel a tile, 0 when the tiles don't fit in a texture
+inline u32 uploadHeatTexture(const Uploader* uploader)
+{
+	return uploader->heatTextures[uploader->drawn];
+}
+
+inline u32 uploadHeatClock(const Uploader* uploader)
+{
+	return uploader->heatClocks[uploader->drawn];
+}
+
+// two u32 an instance, see UPLOAD_BAND_SHIFT
+inline u32 uploadInstances(const Uploader* uploader)
+{
+	return uploader->instanceBuffers[uploader->drawn];
+}
+
+inline u32 uploadInstanceCount(const Uploader* uploader)
+{
+	return uploader->instanceCounts[uploader->drawn];
+}
+
+// ages are a u32 a cell, bands a byte a cell and bits 32 cells a u32 with
+// every row starting on a new one. cell x is bit x % 32 of word x / 32.
+inline u32 uploadFormatTexels(UploadFormat format)
+{
+	return format == UPLOAD_BANDS ? GL_R8UI : GL_R32UI;
+}